@@ -0,0 +1,556 @@
+/*
+  UpdaterBench.cpp - Benchmarks for the updater's hot paths
+  
+  Usage: sampUpdaterBench [json] [extract] [copy] (all benchmarks if
+  none is named)
+  
+  json      ReleaseJsonReader against the juce::JSON::parse path it
+            replaced, on generated /releases pages with many assets
+            per release: time, heap allocations and peak heap use
+  extract   ParallelExtractor on a generated bundle zip (many small
+            deflate entries and a few large ones), on 1, 2, 4 ... N
+            threads: time, throughput and speedup over one thread
+  copy      CopyEngine::copyItem on a generated tree of many small
+            files and one of a few large files, against
+            juce::File::copyDirectoryTo and a buffered copier, then
+            on 1, 2, 4 ... N threads
+  
+  Heap use is measured by replacing the global operator new/delete,
+  so only run one benchmark thread at a time through them.
+*/
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../Source/Config.h"
+#include "../Source/Core/CopyEngine.h"
+#include "../Source/Core/ParallelExtractor.h"
+#include "../Source/Core/ReleaseInfo.h"
+#include "../Source/Core/ReleaseJsonReader.h"
+#include "../Source/Core/ZipArchive.h"
+
+//==============================================================================
+// HEAP ACCOUNTING
+//==============================================================================
+
+namespace
+{
+    std::atomic<juce::int64> numAllocations { 0 };
+    std::atomic<juce::int64> liveBytes { 0 };
+    std::atomic<juce::int64> peakBytes { 0 };
+    
+    // Keeps the block size in front of each block, max_align_t aligned
+    constexpr size_t headerSize = sizeof(std::max_align_t);
+    
+    void* allocate(size_t size)
+    {
+        auto* block = static_cast<char*>(std::malloc(size + headerSize));
+        
+        if (block == nullptr)
+            throw std::bad_alloc();
+        
+        *reinterpret_cast<size_t*>(block) = size;
+        
+        ++numAllocations;
+        auto live = liveBytes += (juce::int64) size;
+        auto peak = peakBytes.load();
+        
+        while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {}
+        
+        return block + headerSize;
+    }
+    
+    void release(void* pointer) noexcept
+    {
+        if (pointer == nullptr)
+            return;
+        
+        auto* block = static_cast<char*>(pointer) - headerSize;
+        liveBytes -= (juce::int64) *reinterpret_cast<size_t*>(block);
+        std::free(block);
+    }
+}
+
+void* operator new(size_t size)                     { return allocate(size); }
+void* operator new[](size_t size)                   { return allocate(size); }
+void operator delete(void* pointer) noexcept        { release(pointer); }
+void operator delete[](void* pointer) noexcept      { release(pointer); }
+void operator delete(void* pointer, size_t) noexcept    { release(pointer); }
+void operator delete[](void* pointer, size_t) noexcept  { release(pointer); }
+
+namespace
+{
+    /**
+     * Allocations and peak heap growth from construction to report()
+     */
+    struct HeapMeter
+    {
+        HeapMeter()
+        {
+            startCount = numAllocations.load();
+            startBytes = liveBytes.load();
+            peakBytes = startBytes;
+            startMs = juce::Time::getMillisecondCounterHiRes();
+        }
+        
+        struct Result
+        {
+            double ms = 0.0;
+            juce::int64 allocations = 0;
+            juce::int64 peak = 0;
+        };
+        
+        Result report() const
+        {
+            return { juce::Time::getMillisecondCounterHiRes() - startMs,
+                     numAllocations.load() - startCount,
+                     peakBytes.load() - startBytes };
+        }
+        
+        juce::int64 startCount = 0, startBytes = 0;
+        double startMs = 0.0;
+    };
+    
+    void printRow(const juce::String& name, const HeapMeter::Result& result)
+    {
+        std::printf("  %-28s %9.2f ms %10lld allocs %9.2f MB peak\n", name.toRawUTF8(), result.ms,
+                    (long long) result.allocations, result.peak / 1048576.0);
+    }
+    
+    juce::File getBenchDir()
+    {
+        return juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("samp_bench");
+    }
+    
+    /**
+     * Compressible but not trivial: numbered lines of sample-ish text
+     */
+    juce::MemoryBlock makeContent(size_t numBytes, juce::Random& random)
+    {
+        juce::MemoryOutputStream out(numBytes + 128);
+        
+        while (out.getDataSize() < numBytes)
+            out << "voice " << random.nextInt(64) << " gain " << random.nextFloat() << " pos "
+                << random.nextInt64() << "\n";
+        
+        return juce::MemoryBlock(out.getData(), numBytes);
+    }
+    
+    /**
+     * 1, 2, 4 ... up to and including the core count
+     */
+    juce::Array<int> getThreadCounts()
+    {
+        juce::Array<int> counts;
+        auto numCpus = juce::SystemStats::getNumCpus();
+        
+        for (int n = 1; n < numCpus; n *= 2)
+            counts.add(n);
+        
+        counts.add(numCpus);
+        return counts;
+    }
+}
+
+//==============================================================================
+// RELEASE JSON
+//==============================================================================
+
+namespace JsonBench
+{
+    /**
+     * A /releases page as GitHub sends it: uploader objects, reactions
+     * and long notes around the few fields the updater reads
+     */
+    juce::MemoryBlock makeReleasePage(int numReleases, int assetsPerRelease)
+    {
+        juce::MemoryOutputStream out;
+        juce::Random random(42);
+        
+        auto user = [](int id)
+        {
+            return juce::String("{\"login\":\"github-actions[bot]\",\"id\":") + juce::String(id) +
+                   ",\"node_id\":\"BOT_kgDOAAAAAA\",\"avatar_url\":\"https://avatars.githubusercontent.com/in/15368?v=4\","
+                   "\"gravatar_id\":\"\",\"url\":\"https://api.github.com/users/github-actions%5Bbot%5D\","
+                   "\"html_url\":\"https://github.com/apps/github-actions\",\"type\":\"Bot\",\"site_admin\":false}";
+        };
+        
+        out << "[";
+        
+        for (int r = 0; r < numReleases; ++r)
+        {
+            auto tag = "v2." + juce::String(numReleases - r) + ".0";
+            juce::String notes;
+            
+            for (int line = 0; line < 200; ++line)
+                notes << "- Fixed issue #" << random.nextInt(5000) << " in the \\\"sampler\\\" voice allocation\\n";
+            
+            out << (r > 0 ? "," : "") << "{\"url\":\"https://api.github.com/repos/xuxxn/samp/releases/" << (1000 + r)
+                << "\",\"id\":" << (1000 + r) << ",\"author\":" << user(r) << ",\"node_id\":\"RE_kwDOAAAA\","
+                << "\"tag_name\":\"" << tag << "\",\"target_commitish\":\"main\",\"name\":\"samp " << tag << "\","
+                << "\"draft\":false,\"prerelease\":" << (r % 4 == 0 ? "true" : "false") << ","
+                << "\"created_at\":\"2026-01-01T10:00:00Z\",\"published_at\":\"2026-01-01T12:00:00Z\",\"assets\":[";
+            
+            for (int a = 0; a < assetsPerRelease; ++a)
+            {
+                auto name = "samp-" + tag + "-build" + juce::String(a) + ".zip";
+                
+                out << (a > 0 ? "," : "") << "{\"url\":\"https://api.github.com/repos/xuxxn/samp/releases/assets/"
+                    << (r * 1000 + a) << "\",\"id\":" << (r * 1000 + a) << ",\"node_id\":\"RA_kwDOAAAA\","
+                    << "\"name\":\"" << name << "\",\"label\":null,\"uploader\":" << user(a) << ","
+                    << "\"content_type\":\"application/zip\",\"state\":\"uploaded\",\"size\":" << random.nextInt(1 << 30) << ","
+                    << "\"digest\":\"sha256:" << juce::String::toHexString(random.nextInt64()).paddedLeft('0', 64) << "\","
+                    << "\"download_count\":" << random.nextInt(10000) << ","
+                    << "\"created_at\":\"2026-01-01T10:00:00Z\",\"updated_at\":\"2026-01-01T10:00:00Z\","
+                    << "\"browser_download_url\":\"https://github.com/xuxxn/samp/releases/download/" << tag << "/" << name << "\"}";
+            }
+            
+            out << "],\"tarball_url\":\"https://api.github.com/repos/xuxxn/samp/tarball/" << tag << "\","
+                << "\"body\":\"" << notes << "\",\"reactions\":{\"total_count\":3,\"+1\":2,\"heart\":1}}";
+        }
+        
+        out << "]";
+        return out.getMemoryBlock();
+    }
+    
+    /**
+     * The path ReleaseJsonReader replaced: the whole response as a
+     * String, a juce::var tree, then the fields read out of it
+     */
+    bool parseWithVar(const juce::MemoryBlock& response, juce::Array<ReleaseInfo>& releases)
+    {
+        juce::MemoryInputStream stream(response, false);
+        auto json = juce::JSON::parse(stream.readEntireStreamAsString());
+        
+        auto* list = json.getArray();
+        
+        if (list == nullptr)
+            return false;
+        
+        for (auto& release : *list)
+        {
+            auto* obj = release.getDynamicObject();
+            
+            if (obj == nullptr)
+                return false;
+            
+            ReleaseInfo info;
+            info.id = (juce::int64) obj->getProperty("id");
+            info.isDraft = obj->getProperty("draft");
+            info.isPrerelease = obj->getProperty("prerelease");
+            info.tagName = obj->getProperty("tag_name").toString();
+            info.version = info.tagName.trimCharactersAtStart("v");
+            info.changelog = obj->getProperty("body").toString();
+            info.releaseDate = juce::Time::fromISO8601(obj->getProperty("published_at").toString());
+            
+            if (auto* assets = obj->getProperty("assets").getArray())
+            {
+                for (auto& a : *assets)
+                {
+                    ReleaseInfo::Asset asset;
+                    asset.name = a["name"].toString();
+                    asset.downloadUrl = a["browser_download_url"].toString();
+                    asset.size = (juce::int64) a["size"];
+                    asset.digest = a["digest"].toString();
+                    info.assets.add(asset);
+                }
+            }
+            
+            releases.add(info);
+        }
+        
+        return true;
+    }
+    
+    bool parseWithReader(const juce::MemoryBlock& response, juce::Array<ReleaseInfo>& releases)
+    {
+        juce::MemoryInputStream stream(response, false);
+        ReleaseJsonReader reader(stream);
+        return reader.readReleaseList(releases);
+    }
+    
+    /**
+     * Best of a few runs, so the first run's cold caches don't count
+     */
+    template <typename Parse>
+    HeapMeter::Result measure(const juce::MemoryBlock& response, Parse parse, int& numAssets)
+    {
+        HeapMeter::Result best;
+        
+        for (int run = 0; run < 5; ++run)
+        {
+            HeapMeter::Result result;
+            
+            {
+                juce::Array<ReleaseInfo> releases;
+                HeapMeter meter;
+                
+                if (!parse(response, releases))
+                    std::printf("  ERROR: parse failed\n");
+                
+                result = meter.report();
+                numAssets = 0;
+                
+                for (auto& release : releases)
+                    numAssets += release.assets.size();
+            }
+            
+            if (run == 0 || result.ms < best.ms)
+                best = result;
+        }
+        
+        return best;
+    }
+    
+    void run()
+    {
+        std::printf("\nRelease JSON: ReleaseJsonReader vs juce::JSON::parse\n");
+        
+        struct Size { int numReleases, assetsPerRelease; };
+        
+        for (auto [numReleases, assetsPerRelease] : { Size { 20, 10 }, Size { 100, 40 } })
+        {
+            auto page = makeReleasePage(numReleases, assetsPerRelease);
+            int varAssets = 0, readerAssets = 0;
+            
+            std::printf(" %d releases x %d assets, %.2f MB\n", numReleases, assetsPerRelease,
+                        page.getSize() / 1048576.0);
+            
+            auto viaVar = measure(page, parseWithVar, varAssets);
+            auto viaReader = measure(page, parseWithReader, readerAssets);
+            
+            printRow("juce::JSON::parse", viaVar);
+            printRow("ReleaseJsonReader", viaReader);
+            
+            if (varAssets != readerAssets)
+                std::printf("  ERROR: asset counts differ (%d vs %d)\n", varAssets, readerAssets);
+        }
+    }
+}
+
+//==============================================================================
+// PARALLEL EXTRACTION
+//==============================================================================
+
+namespace ExtractBench
+{
+    /**
+     * A VST3 bundle with resources: numSmall entries of smallBytes and
+     * numLarge of largeBytes, deflated
+     */
+    juce::File makeZip(const juce::File& zipFile, int numSmall, size_t smallBytes, int numLarge, size_t largeBytes)
+    {
+        juce::ZipFile::Builder builder;
+        juce::Random random(17);
+        
+        for (int i = 0; i < numSmall + numLarge; ++i)
+        {
+            bool isLarge = i < numLarge;
+            auto path = isLarge ? "samp.vst3/Contents/x86_64-linux/part" + juce::String(i) + ".so"
+                                : "samp.vst3/Contents/Resources/sample" + juce::String(i) + ".txt";
+            
+            builder.addEntry(new juce::MemoryInputStream(makeContent(isLarge ? largeBytes : smallBytes, random), true),
+                             6, path, juce::Time::getCurrentTime());
+        }
+        
+        zipFile.getParentDirectory().createDirectory();
+        zipFile.deleteFile();
+        
+        juce::FileOutputStream out(zipFile);
+        builder.writeToStream(out, nullptr);
+        return zipFile;
+    }
+    
+    void run()
+    {
+        std::printf("\nParallel extraction: ParallelExtractor on 1 .. %d threads\n", juce::SystemStats::getNumCpus());
+        
+        if (ResourceGovernor::isDAWActive())
+            std::printf("  WARNING: a DAW is running, the extractor will use one thread\n");
+        
+        auto dir = getBenchDir().getChildFile("extract");
+        ZipArchive zip(makeZip(dir.getChildFile("bundle.zip"), 2000, 32 * 1024, 8, 16 * 1024 * 1024));
+        
+        if (!zip.isValid())
+        {
+            std::printf("  ERROR: generated zip unreadable\n");
+            return;
+        }
+        
+        juce::Array<int> indices;
+        juce::int64 totalBytes = 0;
+        
+        for (int i = 0; i < zip.getEntries().size(); ++i)
+        {
+            indices.add(i);
+            totalBytes += zip.getEntries().getReference(i).size;
+        }
+        
+        std::printf(" %d entries, %.1f MB uncompressed, %.1f MB zip\n", indices.size(), totalBytes / 1048576.0,
+                    zip.getFile().getSize() / 1048576.0);
+        
+        auto dest = dir.getChildFile("out");
+        double oneThreadMs = 0.0;
+        
+        // First pass warms the page cache and is not reported
+        dest.deleteRecursively();
+        ParallelExtractor::extract(zip, indices, dest);
+        
+        for (auto threads : getThreadCounts())
+        {
+            dest.deleteRecursively();
+            
+            auto startMs = juce::Time::getMillisecondCounterHiRes();
+            auto results = ParallelExtractor::extract(zip, indices, dest, threads);
+            auto ms = juce::Time::getMillisecondCounterHiRes() - startMs;
+            
+            int numFailed = 0;
+            
+            for (auto& result : results)
+                numFailed += result.ok ? 0 : 1;
+            
+            if (threads == 1)
+                oneThreadMs = ms;
+            
+            std::printf("  %3d thread(s) %9.1f ms %8.1f MB/s %6.2fx%s\n", threads, ms,
+                        totalBytes / 1048576.0 / juce::jmax(0.001, ms / 1000.0), oneThreadMs / juce::jmax(0.001, ms),
+                        numFailed > 0 ? "  ERROR: CRC/size mismatches" : "");
+        }
+    }
+}
+
+//==============================================================================
+// TREE COPY
+//==============================================================================
+
+namespace CopyBench
+{
+    /**
+     * numFiles files of fileBytes spread over numDirs directories
+     */
+    juce::File makeTree(const juce::File& root, int numDirs, int numFiles, size_t fileBytes)
+    {
+        juce::Random random(23);
+        juce::MemoryBlock data(fileBytes);
+        
+        root.deleteRecursively();
+        
+        for (int i = 0; i < numFiles; ++i)
+        {
+            auto dir = root.getChildFile("Contents/Resources/group" + juce::String(i % numDirs));
+            dir.createDirectory();
+            
+            random.fillBitsRandomly(data.getData(), data.getSize());
+            dir.getChildFile("file" + juce::String(i) + ".bin").replaceWithData(data.getData(), data.getSize());
+        }
+        
+        return root;
+    }
+    
+    /**
+     * Time copy(target) into a target that doesn't exist yet
+     */
+    template <typename Copy>
+    double measure(const juce::File& target, Copy copy, bool& ok)
+    {
+        target.deleteRecursively();
+        
+        auto startMs = juce::Time::getMillisecondCounterHiRes();
+        ok = copy(target);
+        return juce::Time::getMillisecondCounterHiRes() - startMs;
+    }
+    
+    void printCopyRow(const juce::String& name, double ms, juce::int64 totalBytes, double baselineMs, bool ok)
+    {
+        std::printf("  %-28s %9.1f ms %8.1f MB/s %6.2fx%s\n", name.toRawUTF8(), ms,
+                    totalBytes / 1048576.0 / juce::jmax(0.001, ms / 1000.0), baselineMs / juce::jmax(0.001, ms),
+                    ok ? "" : "  ERROR: copy failed");
+    }
+    
+    void runTree(const juce::String& name, const juce::File& source)
+    {
+        auto files = source.findChildFiles(juce::File::findFiles, true, "*", juce::File::FollowSymlinks::no);
+        auto target = source.getSiblingFile(source.getFileNameWithoutExtension() + "_copy.vst3");
+        juce::int64 totalBytes = 0;
+        bool ok = false;
+        
+        for (auto& file : files)
+            totalBytes += file.getSize();
+        
+        std::printf(" %s: %d files, %.1f MB\n", name.toRawUTF8(), files.size(), totalBytes / 1048576.0);
+        
+        // First pass warms the page cache and is not reported
+        measure(target, [&source](const juce::File& t) { return CopyEngine::copyItem(source, t); }, ok);
+        
+        auto juceMs = measure(target, [&source](const juce::File& t) { return source.copyDirectoryTo(t); }, ok);
+        printCopyRow("File::copyDirectoryTo", juceMs, totalBytes, juceMs, ok);
+        
+        // Same flushes as copyItem, but through a user-space buffer
+        auto bufferedMs = measure(target, [&source](const juce::File& t)
+        {
+            return CopyEngine::copyItem(source, t, [](const juce::File& from, const juce::File& to)
+            {
+                return from.copyFileTo(to);
+            }, 1);
+        }, ok);
+        printCopyRow("copyItem, buffered, 1 thread", bufferedMs, totalBytes, juceMs, ok);
+        
+        for (auto threads : getThreadCounts())
+        {
+            auto ms = measure(target, [&source, threads](const juce::File& t)
+            {
+                return CopyEngine::copyItem(source, t, nullptr, threads);
+            }, ok);
+            
+            printCopyRow("copyItem, " + juce::String(threads) + " thread(s)", ms, totalBytes, juceMs, ok);
+        }
+        
+        target.deleteRecursively();
+    }
+    
+    void run()
+    {
+        std::printf("\nTree copy: CopyEngine::copyItem (speedup over File::copyDirectoryTo,\n"
+                    " which does not flush to disk)\n");
+        
+        if (ResourceGovernor::isDAWActive())
+            std::printf("  WARNING: a DAW is running, copyItem will use one thread\n");
+        
+        auto dir = getBenchDir().getChildFile("copy");
+        
+        runTree("small files", makeTree(dir.getChildFile("small.vst3"), 64, 5000, 4 * 1024));
+        runTree("large files", makeTree(dir.getChildFile("large.vst3"), 1, 4, 64 * 1024 * 1024));
+    }
+}
+
+//==============================================================================
+
+int main(int argc, char* argv[])
+{
+    juce::StringArray names;
+    
+    for (int i = 1; i < argc; ++i)
+        names.add(argv[i]);
+    
+    auto wants = [&names](const char* name)
+    {
+        return names.isEmpty() || names.contains(name);
+    };
+    
+    getBenchDir().deleteRecursively();
+    
+    if (wants("json"))
+        JsonBench::run();
+    
+    if (wants("extract"))
+        ExtractBench::run();
+    
+    if (wants("copy"))
+        CopyBench::run();
+    
+    getBenchDir().deleteRecursively();
+    return 0;
+}
\ No newline at end of file
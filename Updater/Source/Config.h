@@ -20,7 +20,7 @@ namespace UpdaterConfig
     {
         return "https://api.github.com/repos/" + 
                juce::String(GITHUB_OWNER) + "/" + 
-               juce::String(GITHUB_REPO) + "/releases/latest";
+               juce::String(GITHUB_REPO) + "/releases";
     }
     
     //==========================================================================
@@ -78,6 +78,46 @@ namespace UpdaterConfig
             .getChildFile("updater_prefs.xml");
     }
     
+    /**
+     * Get local release index path (stored next to preferences)
+     */
+    inline juce::File getReleaseIndexFile()
+    {
+        return getPreferencesFile().getSiblingFile("release_index.xml");
+    }
+    
+    /**
+     * Get asset mirror list path (one base URL per line, '#' comments)
+     */
+    inline juce::File getMirrorListFile()
+    {
+        return getPreferencesFile().getSiblingFile("mirrors.txt");
+    }
+    
+    /**
+     * Get API rate limit / check schedule state path
+     */
+    inline juce::File getScheduleFile()
+    {
+        return getPreferencesFile().getSiblingFile("request_schedule.xml");
+    }
+    
+    /**
+     * Get the installed files record (release manifest + verification state)
+     */
+    inline juce::File getInstalledFilesFile()
+    {
+        return getPreferencesFile().getSiblingFile("installed_files.xml");
+    }
+    
+    /**
+     * Get install journal path (exists only while an install is in progress)
+     */
+    inline juce::File getInstallJournalFile()
+    {
+        return getPreferencesFile().getSiblingFile("install_journal.txt");
+    }
+    
     /**
      * Get log file path
      */
@@ -102,6 +142,14 @@ namespace UpdaterConfig
         return temp.getChildFile("samp_update");
     }
     
+    /**
+     * Where the plugin is unpacked from a downloaded archive
+     */
+    inline juce::File getStagingDir()
+    {
+        return getTempDownloadDir().getChildFile("staging");
+    }
+    
     /**
      * Get backup file path
      */
@@ -111,13 +159,87 @@ namespace UpdaterConfig
         return plugin.withFileExtension(".vst3.backup");
     }
     
+    /**
+     * Retained plugin versions (see InstallStore). Beside the VST3 folder,
+     * so hosts don't scan it, and on the same volume, so versions are
+     * hard-linked and renamed rather than copied.
+     */
+    inline juce::File getInstallStoreDir()
+    {
+        auto plugin = getPluginInstallPath();
+        
+        if (plugin == juce::File())
+            return {};
+        
+        return plugin.getParentDirectory().getSiblingFile(juce::String(PLUGIN_DISPLAY_NAME) + "_store");
+    }
+    
+    //==========================================================================
+    // INSTALL TARGETS
+    //==========================================================================
+    
+    /**
+     * One place an update is installed to
+     */
+    struct InstallTarget
+    {
+        juce::String artifact;          // Item in the release archive, e.g. "samp.clap"
+        juce::File path;                // Where it goes
+        bool onlyIfInstalled = false;   // Updated where present, never created (e.g. system-wide scopes)
+    };
+    
+    /**
+     * Everything an update installs, all in one transaction. The first
+     * target is the plugin at getPluginInstallPath(); backups, rollback
+     * and verification are about it. The others get their artifact if
+     * the release ships it. Several targets can share an artifact: it is
+     * downloaded and unpacked once.
+     */
+    inline juce::Array<InstallTarget> getInstallTargets()
+    {
+        auto name = juce::String(PLUGIN_DISPLAY_NAME);
+        juce::Array<InstallTarget> targets;
+        targets.add({ PLUGIN_NAME, getPluginInstallPath() });
+
+        #if JUCE_WINDOWS
+            auto userDir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                               .getChildFile(COMPANY_NAME);
+            auto commonFiles = juce::File::getSpecialLocation(juce::File::globalApplicationsDirectory)
+                                   .getChildFile("Common Files");
+            
+            targets.add({ PLUGIN_NAME, commonFiles.getChildFile("VST3").getChildFile(PLUGIN_NAME), true });
+            targets.add({ name + ".clap", userDir.getChildFile("CLAP").getChildFile(name + ".clap") });
+            targets.add({ name + ".exe", userDir.getChildFile(name).getChildFile(name + ".exe") });
+
+        #elif JUCE_MAC
+            auto userPlugins = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                                   .getChildFile("Audio/Plug-Ins");
+            auto systemPlugins = juce::File("/Library/Audio/Plug-Ins");
+            
+            targets.add({ PLUGIN_NAME, systemPlugins.getChildFile("VST3").getChildFile(PLUGIN_NAME), true });
+            targets.add({ name + ".component", userPlugins.getChildFile("Components").getChildFile(name + ".component") });
+            targets.add({ name + ".clap", userPlugins.getChildFile("CLAP").getChildFile(name + ".clap") });
+            targets.add({ name + ".app", juce::File::getSpecialLocation(juce::File::userHomeDirectory)
+                                             .getChildFile("Applications").getChildFile(name + ".app") });
+        #endif
+
+        return targets;
+    }
+    
     //==========================================================================
     // UPDATE SETTINGS
     //==========================================================================
     
+    // Releases per /releases page, and pages fetched at most per sync
+    inline constexpr int RELEASE_PAGE_SIZE = 20;
+    inline constexpr int RELEASE_MAX_PAGES = 5;
+    
     // Check for updates every 24 hours
     inline constexpr int CHECK_INTERVAL_HOURS = 24;
     
+    // Automatic checks land up to this far either side of the interval
+    inline constexpr int CHECK_JITTER_MINUTES = 60;
+    
     // Auto-update enabled by default
     inline constexpr bool AUTO_UPDATE_DEFAULT = true;
     
@@ -127,6 +249,109 @@ namespace UpdaterConfig
     // Check for beta versions
     inline constexpr bool CHECK_BETA_DEFAULT = false;
     
+    // Installed versions kept for instant rollback (files shared between them are stored once)
+    inline constexpr int INSTALL_GENERATIONS_KEPT = 3;
+    
+    //==========================================================================
+    // NETWORK SETTINGS
+    //==========================================================================
+    
+    // Connection timeout for API requests
+    inline constexpr int HTTP_TIMEOUT_MS = 15000;
+    
+    // Parallel byte-range connections per download (1 = single stream)
+    inline constexpr int DOWNLOAD_SEGMENTS = 4;
+    
+    // Don't split downloads into ranges smaller than this
+    inline constexpr juce::int64 MIN_SEGMENT_BYTES = 1024 * 1024;
+    
+    // How long a resolved redirect target (signed CDN URL) is reused
+    inline constexpr int REDIRECT_CACHE_MS = 60 * 1000;
+    
+    // Reconnect attempts per range before the download fails
+    inline constexpr int MAX_SEGMENT_RETRIES = 3;
+    
+    // API retries after 5xx / timeouts / resets, with backoff from BASE up to MAX
+    inline constexpr int API_MAX_RETRIES = 4;
+    inline constexpr int API_BACKOFF_BASE_MS = 1000;
+    inline constexpr int API_BACKOFF_MAX_MS = 60 * 1000;
+    
+    // Rate limits ending sooner than this are waited out; longer ones defer the check
+    inline constexpr int API_MAX_INLINE_WAIT_MS = 30 * 1000;
+    
+    //==========================================================================
+    // ASSET MIRRORS
+    //==========================================================================
+    
+    /**
+     * Servers carrying the same release assets as GitHub, laid out as
+     * <base>/<tag>/<asset name> (a studio file server, or a local HTTP
+     * server for offline setups). Read from getMirrorListFile().
+     */
+    inline juce::StringArray getAssetMirrors()
+    {
+        juce::StringArray mirrors;
+        
+        for (auto line : juce::StringArray::fromLines(getMirrorListFile().loadFileAsString()))
+        {
+            line = line.upToFirstOccurrenceOf("#", false, false).trim();
+            
+            if (line.startsWithIgnoreCase("http://") || line.startsWithIgnoreCase("https://"))
+                mirrors.addIfNotAlreadyThere(line.trimCharactersAtEnd("/"));
+        }
+        
+        return mirrors;
+    }
+    
+    // Head start each source gets before the next one is probed
+    inline constexpr int MIRROR_STAGGER_MS = 250;
+    
+    // Probe timeout; a source slower than this is only used for failover
+    inline constexpr int MIRROR_PROBE_TIMEOUT_MS = 3000;
+    
+    // Switch sources when a download makes no progress for this long
+    inline constexpr int MIRROR_STALL_MS = 5000;
+    
+    //==========================================================================
+    // DAW-FRIENDLY MODE
+    //==========================================================================
+    
+    // Download cap while a DAW is running (bytes per second, 0 = no cap)
+    inline constexpr juce::int64 DAW_BANDWIDTH_LIMIT = 512 * 1024;
+    
+    // How often running DAWs are re-checked while updater work is active
+    inline constexpr int DAW_POLL_INTERVAL_MS = 10000;
+    
+    // How often a repair of installed files postponed by a running DAW is tried again
+    inline constexpr int REPAIR_RETRY_INTERVAL_MS = 60000;
+    
+    // Rebuild the plugin from a release's delta patch when one matches
+    inline constexpr bool DELTA_UPDATES_ENABLED = true;
+    
+    // Rebuild from local blocks + ranged downloads when a block map is published
+    inline constexpr bool BLOCK_SYNC_ENABLED = true;
+    
+    // Missing ranges closer than this are fetched as one request
+    inline constexpr juce::int64 BLOCK_SYNC_MERGE_GAP = 64 * 1024;
+    
+    // Unpack archives while they download instead of saving them first
+    inline constexpr bool STREAMED_EXTRACTION_ENABLED = true;
+    
+    // How far the network may read ahead of a streamed extraction
+    inline constexpr int STREAM_READ_AHEAD_BYTES = 4 * 1024 * 1024;
+    
+    // Threads decompressing zip entries (0 = one per core)
+    inline constexpr int EXTRACT_THREADS = 0;
+    
+    // Threads copying bundle files (0 = one per core)
+    inline constexpr int COPY_THREADS = 0;
+    
+    // Threads hashing installed files for verification (0 = one per core)
+    inline constexpr int VERIFY_THREADS = 0;
+    
+    // How often partial downloads are flushed and their manifest saved
+    inline constexpr int RESUME_CHECKPOINT_MS = 1000;
+    
     //==========================================================================
     // UI SETTINGS
     //==========================================================================
@@ -134,6 +359,9 @@ namespace UpdaterConfig
     inline constexpr int WINDOW_WIDTH = 500;
     inline constexpr int WINDOW_HEIGHT = 400;
     
+    // How often the window polls download progress
+    inline constexpr int PROGRESS_REFRESH_HZ = 10;
+    
     //==========================================================================
     // KNOWN DAW PROCESSES (for process monitoring)
     //==========================================================================
@@ -151,7 +379,9 @@ namespace UpdaterConfig
             "REAPER.exe",         // Reaper (alternative case)
             "Logic Pro X",        // Logic Pro (macOS)
             "Bitwig Studio.exe",  // Bitwig
-            "Renoise.exe"         // Renoise
+            "Renoise.exe",        // Renoise
+            "bitwig-studio",      // Bitwig (Linux)
+            "ardour*"             // Ardour (Linux)
         };
     }
     
@@ -187,7 +417,7 @@ namespace UpdaterConfig
      */
     inline bool isPluginInstalled()
     {
-        return getPluginInstallPath().existsAsFile();
+        return getPluginInstallPath().exists();
     }
     
     /**
@@ -0,0 +1,614 @@
+/*
+  ArchiveExtractor.h - Unpack downloaded release assets
+  
+  Supported encodings (everything JUCE can decode without extra
+  libraries): plain binary, .zip, .gz, .tar, .tar.gz / .tgz.
+  Gzip and tar are decoded as a stream straight to the output files.
+  Zip, gzip and tar can also be unpacked from a stream that is still
+  downloading (extractStream), so the archive never touches the disk.
+  Formats without a decoder here (.zst, .xz, .bz2, ...) are reported as
+  unsupported so asset selection never picks them.
+  
+  Only the plugin is unpacked: the first path component named *.vst3
+  (a single file on Windows, a bundle directory elsewhere) is the
+  payload, together with the other formats the install targets name
+  (CLAP, AU, standalone; see UpdaterConfig::getInstallTargets). Every
+  other entry (e.g. Updater.exe) is skipped.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "ParallelExtractor.h"
+#include "ZipArchive.h"
+#include "ZipStreamReader.h"
+
+class ArchiveExtractor
+{
+public:
+    enum class Format
+    {
+        plain,
+        zip,
+        gzip,
+        tar,
+        tarGzip,
+        unsupported
+    };
+    
+    static Format getFormat(const juce::String& fileName)
+    {
+        auto name = fileName.toLowerCase();
+        
+        if (name.endsWith(".zip"))                              return Format::zip;
+        if (name.endsWith(".tar.gz") || name.endsWith(".tgz"))  return Format::tarGzip;
+        if (name.endsWith(".tar"))                              return Format::tar;
+        if (name.endsWith(".gz"))                               return Format::gzip;
+        
+        for (auto* ext : { ".zst", ".zstd", ".xz", ".lzma", ".bz2", ".7z", ".rar", ".lz4", ".br" })
+            if (name.endsWith(ext))
+                return Format::unsupported;
+        
+        return Format::plain;
+    }
+    
+    static bool canExtract(const juce::String& fileName)
+    {
+        return getFormat(fileName) != Format::unsupported;
+    }
+    
+    /**
+     * True for archives extractStream can unpack front to back
+     */
+    static bool canStream(const juce::String& fileName)
+    {
+        auto format = getFormat(fileName);
+        return format != Format::plain && format != Format::unsupported;
+    }
+    
+    /**
+     * Unpack the plugin in file into destDir and return it (the bundle
+     * root for bundles). Plain files are returned as they are. Returns
+     * an empty File if the archive can't be read or holds no .vst3.
+     */
+    static juce::File extract(const juce::File& file, const juce::File& destDir)
+    {
+        auto format = getFormat(file.getFileName());
+        
+        if (format == Format::plain)
+            return file;
+        
+        UpdaterConfig::logMessage("Extracting " + file.getFileName() + "...");
+        destDir.createDirectory();
+        
+        if (format == Format::zip)
+            return extractZip(file, destDir);
+        
+        juce::FileInputStream in(file);
+        
+        if (in.failedToOpen())
+        {
+            UpdaterConfig::logMessage("ERROR: Can't open " + file.getFullPathName());
+            return {};
+        }
+        
+        return extractStream(in, file.getFileName(), destDir);
+    }
+    
+    /**
+     * Unpack an archive read front to back from in, e.g. while it is
+     * still downloading. fileName only decides the format.
+     * Returns the plugin inside it, or an empty File on failure.
+     */
+    static juce::File extractStream(juce::InputStream& in, const juce::String& fileName, const juce::File& destDir)
+    {
+        auto format = getFormat(fileName);
+        destDir.createDirectory();
+        
+        switch (format)
+        {
+            case Format::zip:       return extractZipStream(in, fileName, destDir);
+            case Format::gzip:      return extractGzip(in, fileName, destDir);
+            case Format::tar:
+            case Format::tarGzip:   return extractTar(in, fileName, destDir, format == Format::tarGzip);
+            case Format::plain:
+            case Format::unsupported:
+            default:                break;
+        }
+        
+        UpdaterConfig::logMessage("ERROR: No decoder for " + fileName);
+        return {};
+    }
+
+    /**
+     * The outermost .vst3 among a zip's entries, whatever order they are
+     * in (empty if there is none)
+     */
+    static juce::String findBundleRoot(const juce::Array<ZipArchive::Entry>& entries)
+    {
+        juce::String found;
+        
+        for (auto& entry : entries)
+        {
+            auto root = getBundleRoot(entry.path);
+            
+            if (root.isNotEmpty() && (found.isEmpty() || root.length() < found.length()))
+                found = root;
+        }
+        
+        return found;
+    }
+    
+    /**
+     * The outermost item called name that was unpacked into destDir next
+     * to the plugin (an artifact for another install target), or an
+     * empty File if the archive had none
+     */
+    static juce::File findArtifact(const juce::File& destDir, const juce::String& name)
+    {
+        juce::File found;
+        
+        for (auto& item : destDir.findChildFiles(juce::File::findFilesAndDirectories, true, name,
+                                                 juce::File::FollowSymlinks::no))
+        {
+            if (found == juce::File() || item.getFullPathName().length() < found.getFullPathName().length())
+                found = item;
+        }
+        
+        return found;
+    }
+    
+    /**
+     * No absolute paths and no ".." (an archive or manifest must stay
+     * inside the directory it is unpacked into)
+     */
+    static bool isSafePath(const juce::String& path)
+    {
+        if (path.isEmpty() || path.startsWithChar('/') || path.startsWithChar('\\') || path.containsChar(':'))
+            return false;
+        
+        for (auto& part : juce::StringArray::fromTokens(path, "/\\", {}))
+            if (part == "..")
+                return false;
+        
+        return true;
+    }
+
+private:
+    static constexpr int chunkSize = 64 * 1024;
+    
+    //==========================================================================
+    // ZIP
+    //==========================================================================
+    
+    /**
+     * The central directory lists every entry up front, so the payload
+     * is picked first and nothing else is decompressed. Its entries are
+     * decoded in parallel (see ParallelExtractor).
+     */
+    static juce::File extractZip(const juce::File& file, const juce::File& destDir)
+    {
+        ZipArchive zip(file);
+        
+        if (!zip.isValid())
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to read ZIP " + file.getFileName());
+            return {};
+        }
+        
+        auto& entries = zip.getEntries();
+        PayloadFilter payload;
+        payload.root = findBundleRoot(entries);
+        
+        juce::Array<int> selected;
+        
+        for (int i = 0; i < entries.size(); ++i)
+        {
+            auto& path = entries.getReference(i).path;
+            
+            if (!payload.accepts(path))
+                continue;
+            
+            if (!isSafePath(path))
+            {
+                UpdaterConfig::logMessage("ERROR: Unsafe path in archive: " + path);
+                return {};
+            }
+            
+            selected.add(i);
+        }
+        
+        bool failed = false;
+        
+        for (auto& result : ParallelExtractor::extract(zip, selected, destDir))
+        {
+            if (!result.ok)
+            {
+                UpdaterConfig::logMessage("ERROR: Failed to extract " + result.path + ": " + result.error);
+                failed = true;
+            }
+        }
+        
+        return failed ? juce::File() : getPlugin(payload, selected.size(), entries.size(), destDir);
+    }
+    
+    /**
+     * Local headers in archive order; the central directory only adds
+     * the Unix mode bits at the end. Entries outside the payload are
+     * skipped (still decoded if only a data descriptor gives their size).
+     */
+    static juce::File extractZipStream(juce::InputStream& in, const juce::String& fileName, const juce::File& destDir)
+    {
+        juce::StringArray paths;
+        PayloadFilter payload;
+        int numEntries = 0;
+        bool unsafe = false;
+        
+        auto onEntry = [&](const ZipStreamReader::Entry& entry) -> std::unique_ptr<juce::OutputStream>
+        {
+            ++numEntries;
+            
+            if (!payload.accepts(entry.path))
+                return nullptr;
+            
+            if (!isSafePath(entry.path))
+            {
+                UpdaterConfig::logMessage("ERROR: Unsafe path in archive: " + entry.path);
+                unsafe = true;
+                return nullptr;
+            }
+            
+            auto target = destDir.getChildFile(entry.path);
+            paths.add(entry.path);
+            
+            if (entry.isDirectory)
+            {
+                target.createDirectory();
+                return nullptr;
+            }
+            
+            target.getParentDirectory().createDirectory();
+            target.deleteFile();
+            
+            auto out = std::make_unique<juce::FileOutputStream>(target);
+            
+            if (out->failedToOpen())
+                return std::make_unique<FailingOutputStream>();
+            
+            return out;
+        };
+        
+        auto onMode = [&](const juce::String& path, juce::uint32 mode)
+        {
+            if (!unsafe && (mode & 0111) != 0 && paths.contains(path) && !path.endsWithChar('/'))
+                destDir.getChildFile(path).setExecutePermission(true);
+        };
+        
+        ZipStreamReader reader(in);
+        
+        if (!reader.read(onEntry, onMode) || unsafe)
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to extract " + fileName);
+            return {};
+        }
+        
+        return getPlugin(payload, paths.size(), numEntries, destDir);
+    }
+    
+    //==========================================================================
+    // GZIP (single file)
+    //==========================================================================
+    
+    /**
+     * "samp-2.1.0-Windows.vst3.gz" -> "samp-2.1.0-Windows.vst3"
+     */
+    static juce::File extractGzip(juce::InputStream& source, const juce::String& fileName, const juce::File& destDir)
+    {
+        auto output = destDir.getChildFile(fileName.upToLastOccurrenceOf(".", false, false));
+        
+        juce::GZIPDecompressorInputStream in(&source, false,
+                                             juce::GZIPDecompressorInputStream::gzipFormat);
+        
+        output.deleteFile();
+        bool ok = false;
+        
+        {
+            juce::FileOutputStream out(output);
+            ok = !out.failedToOpen() && copy(in, out, -1) && out.getStatus().wasOk();
+        }
+        
+        if (!ok || output.getSize() == 0)
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to decompress " + fileName);
+            output.deleteFile();
+            return {};
+        }
+        
+        UpdaterConfig::logMessage("Decompressed: " + output.getFullPathName());
+        return output;
+    }
+    
+    //==========================================================================
+    // TAR (ustar, GNU long names, pax paths)
+    //==========================================================================
+    
+    static juce::File extractTar(juce::InputStream& source, const juce::String& fileName,
+                                 const juce::File& destDir, bool gzipped)
+    {
+        juce::OptionalScopedPointer<juce::InputStream> in(&source, false);
+        
+        if (gzipped)
+            in.set(new juce::GZIPDecompressorInputStream(&source, false, juce::GZIPDecompressorInputStream::gzipFormat), true);
+        
+        PayloadFilter payload;
+        int numEntries = 0, numExtracted = 0;
+        juce::String longName;
+        char header[512];
+        
+        for (;;)
+        {
+            if (in->read(header, 512) != 512)
+                return tarFailed(fileName);
+            
+            // Two zero blocks end the archive; one is enough to stop
+            if (header[0] == 0)
+                break;
+            
+            auto size = parseOctal(header + 124, 12);
+            auto type = header[156];
+            auto padded = (size + 511) & ~(juce::int64) 511;
+            
+            if (size < 0)
+                return tarFailed(fileName);
+            
+            // Extended headers name the entry that follows
+            if (type == 'L' || type == 'x')
+            {
+                juce::MemoryBlock data;
+                
+                if (in->readIntoMemoryBlock(data, (juce::ssize_t) padded) != (size_t) padded)
+                    return tarFailed(fileName);
+                
+                auto text = juce::String::fromUTF8(static_cast<const char*>(data.getData()),
+                                                   (int) juce::jmin<juce::int64>(size, (juce::int64) data.getSize()));
+                longName = type == 'L' ? text : parsePaxPath(text);
+                continue;
+            }
+            
+            auto path = longName.isNotEmpty() ? longName : readHeaderPath(header);
+            longName.clear();
+            ++numEntries;
+            
+            // Not part of the plugin: skip its data
+            if (!payload.accepts(path))
+            {
+                if (padded > 0 && !skip(*in, padded))
+                    return tarFailed(fileName);
+                
+                continue;
+            }
+            
+            if (!isSafePath(path))
+            {
+                UpdaterConfig::logMessage("ERROR: Unsafe path in archive: " + path);
+                return {};
+            }
+            
+            auto target = destDir.getChildFile(path);
+            
+            if (type == '5')
+            {
+                target.createDirectory();
+                ++numExtracted;
+            }
+            else if (type == '0' || type == 0 || type == '7')
+            {
+                target.getParentDirectory().createDirectory();
+                target.deleteFile();
+                
+                juce::FileOutputStream out(target);
+                
+                if (out.failedToOpen() || !copy(*in, out, size) || !out.getStatus().wasOk())
+                    return tarFailed(fileName);
+                
+                // Bundles carry their executable bit
+                if ((parseOctal(header + 100, 8) & 0111) != 0)
+                    target.setExecutePermission(true);
+                
+                ++numExtracted;
+                padded -= size;
+            }
+            
+            // Skip data of other entry types (links, devices) and block padding
+            if (padded > 0 && !skip(*in, padded))
+                return tarFailed(fileName);
+        }
+        
+        return getPlugin(payload, numExtracted, numEntries, destDir);
+    }
+    
+    static juce::String readHeaderPath(const char* header)
+    {
+        auto name = juce::String::fromUTF8(header, (int) strnlen(header, 100));
+        
+        // ustar splits long paths into prefix + name
+        if (std::memcmp(header + 257, "ustar", 5) == 0 && header[345] != 0)
+            name = juce::String::fromUTF8(header + 345, (int) strnlen(header + 345, 155)) + "/" + name;
+        
+        return name;
+    }
+    
+    /**
+     * "<len> path=<value>\n" records
+     */
+    static juce::String parsePaxPath(const juce::String& text)
+    {
+        for (auto& line : juce::StringArray::fromLines(text))
+        {
+            auto record = line.fromFirstOccurrenceOf(" ", false, false);
+            
+            if (record.startsWith("path="))
+                return record.substring(5);
+        }
+        
+        return {};
+    }
+    
+    static juce::int64 parseOctal(const char* field, int length)
+    {
+        juce::int64 value = 0;
+        
+        for (int i = 0; i < length && field[i] != 0 && field[i] != ' '; ++i)
+        {
+            if (field[i] < '0' || field[i] > '7')
+                return -1;
+            
+            value = value * 8 + (field[i] - '0');
+        }
+        
+        return value;
+    }
+    
+    static juce::File tarFailed(const juce::String& fileName)
+    {
+        UpdaterConfig::logMessage("ERROR: Failed to extract " + fileName);
+        return {};
+    }
+    
+    //==========================================================================
+    // HELPERS
+    //==========================================================================
+    
+    /**
+     * "samp.vst3/Contents/x86_64-win/samp.vst3" -> "samp.vst3":
+     * the path up to its first component named *.vst3 (empty if none)
+     */
+    static juce::String getBundleRoot(const juce::String& path)
+    {
+        auto parts = juce::StringArray::fromTokens(path, "/\\", {});
+        parts.removeEmptyStrings();
+        
+        for (int i = 0; i < parts.size(); ++i)
+            if (parts[i].endsWithIgnoreCase(".vst3"))
+                return parts.joinIntoString("/", 0, i + 1);
+        
+        return {};
+    }
+    
+    /**
+     * "bin/samp.clap/Contents/..." -> "bin/samp.clap": the path up to
+     * its first component named like one of artifacts (empty if none)
+     */
+    static juce::String getArtifactRoot(const juce::String& path, const juce::StringArray& artifacts)
+    {
+        auto parts = juce::StringArray::fromTokens(path, "/\\", {});
+        parts.removeEmptyStrings();
+        
+        for (int i = 0; i < parts.size(); ++i)
+            if (artifacts.contains(parts[i], true))
+                return parts.joinIntoString("/", 0, i + 1);
+        
+        return {};
+    }
+    
+    /**
+     * Artifacts the install targets want besides the VST3
+     */
+    static juce::StringArray getExtraArtifacts()
+    {
+        juce::StringArray names;
+        
+        for (auto& target : UpdaterConfig::getInstallTargets())
+            if (!target.artifact.endsWithIgnoreCase(".vst3"))
+                names.addIfNotAlreadyThere(target.artifact, true);
+        
+        return names;
+    }
+    
+    /**
+     * Passes the plugin's entries and those of the other artifacts only.
+     * Unless set up front, the root is the bundle of the first entry
+     * that has one.
+     */
+    struct PayloadFilter
+    {
+        juce::String root;
+        juce::StringArray extras = getExtraArtifacts();
+        
+        bool accepts(const juce::String& path)
+        {
+            if (root.isEmpty())
+                root = getBundleRoot(path);
+            
+            if (root.isNotEmpty() && (path == root || path.startsWith(root + "/")))
+                return true;
+            
+            return getArtifactRoot(path, extras).isNotEmpty();
+        }
+    };
+                
+    static juce::File getPlugin(const PayloadFilter& payload, int numExtracted, int numEntries,
+                                const juce::File& destDir)
+    {
+        if (payload.root.isEmpty() || numExtracted == 0)
+        {
+            UpdaterConfig::logMessage("ERROR: Archive contains no .vst3");
+            return {};
+        }
+        
+        auto plugin = destDir.getChildFile(payload.root);
+        UpdaterConfig::logMessage("Found VST3: " + plugin.getFullPathName() + " (" + juce::String(numExtracted) +
+                                " of " + juce::String(numEntries) + " entries extracted)");
+        return plugin;
+    }
+    
+    static bool copy(juce::InputStream& in, juce::OutputStream& out, juce::int64 numBytes)
+    {
+        juce::HeapBlock<char> buffer(chunkSize);
+        
+        while (numBytes != 0)
+        {
+            auto wanted = numBytes < 0 ? chunkSize : (int) juce::jmin<juce::int64>(chunkSize, numBytes);
+            auto n = in.read(buffer.getData(), wanted);
+            
+            if (n <= 0)
+                return numBytes < 0;
+            
+            if (!out.write(buffer.getData(), (size_t) n))
+                return false;
+            
+            if (numBytes > 0)
+                numBytes -= n;
+        }
+        
+        return true;
+    }
+    
+    /**
+     * Stands in for a file that couldn't be opened, so the reader stops
+     */
+    struct FailingOutputStream : public juce::OutputStream
+    {
+        void flush() override {}
+        bool setPosition(juce::int64) override { return false; }
+        juce::int64 getPosition() override { return 0; }
+        bool write(const void*, size_t) override { return false; }
+    };
+    
+    static bool skip(juce::InputStream& in, juce::int64 numBytes)
+    {
+        char buffer[4096];
+        
+        while (numBytes > 0)
+        {
+            auto n = in.read(buffer, (int) juce::jmin<juce::int64>(sizeof(buffer), numBytes));
+            
+            if (n <= 0)
+                return false;
+            
+            numBytes -= n;
+        }
+        
+        return true;
+    }
+};
\ No newline at end of file
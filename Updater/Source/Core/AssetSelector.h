@@ -0,0 +1,156 @@
+/*
+  AssetSelector.h - Pick the release asset to download
+  
+  Every candidate is scored by platform and architecture, taken from
+  name tokens such as "Windows", "macOS", "x64" or "arm64". Assets for
+  another platform or architecture, and encodings ArchiveExtractor
+  can't decode, are ruled out. Among the best matches the smallest
+  asset wins, so a release that ships the same plugin several ways
+  costs the fewest bytes.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "ArchiveExtractor.h"
+#include "ReleaseInfo.h"
+
+class AssetSelector
+{
+public:
+    /**
+     * Index of the asset to download, or -1 if none fits this machine.
+     * candidates: the release's plugin assets (no checksums/patches/maps)
+     */
+    static int choose(const juce::Array<ReleaseInfo::Asset>& candidates)
+    {
+        int best = -1;
+        int bestScore = 0;
+        
+        for (int i = 0; i < candidates.size(); ++i)
+        {
+            auto& asset = candidates.getReference(i);
+            auto score = getScore(asset.name);
+            
+            if (score <= 0)
+                continue;
+            
+            if (best < 0 || score > bestScore
+                || (score == bestScore && isSmaller(asset, candidates.getReference(best))))
+            {
+                best = i;
+                bestScore = score;
+            }
+        }
+        
+        if (best >= 0)
+            UpdaterConfig::logMessage("Selected asset: " + candidates.getReference(best).name +
+                                    " (" + juce::String(candidates.getReference(best).size) + " bytes)");
+        
+        return best;
+    }
+    
+    /**
+     * 0 = unusable here. Otherwise higher is a more specific match:
+     * platform and architecture each count 2 if named and matching,
+     * 1 if not named at all.
+     */
+    static int getScore(const juce::String& name)
+    {
+        auto lower = name.toLowerCase();
+        
+        if (!lower.contains(".vst3") && !lower.contains(juce::String(UpdaterConfig::PLUGIN_DISPLAY_NAME).toLowerCase()))
+            return 0;
+        
+        if (!ArchiveExtractor::canExtract(name))
+            return 0;
+        
+        auto tokens = juce::StringArray::fromTokens(lower.replace("x86_64", "x64"), "-_. ", {});
+        
+        auto platform = matchTokens(tokens, getPlatformTokens(), getOtherPlatformTokens());
+        auto arch = matchTokens(tokens, getArchTokens(), getOtherArchTokens());
+        
+        if (platform == 0 || arch == 0)
+            return 0;
+        
+        return platform * 4 + arch;
+    }
+
+private:
+    /**
+     * 2 if a token names us, 0 if one only names something else, 1 if neither
+     */
+    static int matchTokens(const juce::StringArray& tokens,
+                           const juce::StringArray& ours,
+                           const juce::StringArray& others)
+    {
+        bool mentionsOther = false;
+        
+        for (auto& token : tokens)
+        {
+            if (ours.contains(token))
+                return 2;
+            
+            mentionsOther = mentionsOther || others.contains(token);
+        }
+        
+        return mentionsOther ? 0 : 1;
+    }
+    
+    static bool isSmaller(const ReleaseInfo::Asset& a, const ReleaseInfo::Asset& b)
+    {
+        // Unknown sizes lose to known ones
+        if (a.size <= 0)
+            return false;
+        
+        return b.size <= 0 || a.size < b.size;
+    }
+    
+    //==========================================================================
+    // NAME TOKENS
+    //==========================================================================
+    
+    static juce::StringArray getPlatformTokens()
+    {
+        #if JUCE_WINDOWS
+            return { "windows", "win", "win32", "win64" };
+        #elif JUCE_MAC
+            return { "mac", "macos", "osx", "darwin" };
+        #else
+            return { "linux" };
+        #endif
+    }
+    
+    static juce::StringArray getOtherPlatformTokens()
+    {
+        #if JUCE_WINDOWS
+            return { "mac", "macos", "osx", "darwin", "linux" };
+        #elif JUCE_MAC
+            return { "windows", "win", "win32", "win64", "linux" };
+        #else
+            return { "windows", "win", "win32", "win64", "mac", "macos", "osx", "darwin" };
+        #endif
+    }
+    
+    static juce::StringArray getArchTokens()
+    {
+        #if defined(__aarch64__) || defined(_M_ARM64)
+            return { "arm64", "aarch64", "universal" };
+        #elif JUCE_64BIT
+            return { "x64", "amd64", "win64", "universal" };
+        #else
+            return { "x86", "i386", "i686" };
+        #endif
+    }
+    
+    static juce::StringArray getOtherArchTokens()
+    {
+        #if defined(__aarch64__) || defined(_M_ARM64)
+            return { "x64", "x86", "amd64", "i386", "i686" };
+        #elif JUCE_64BIT
+            return { "arm64", "aarch64", "x86", "i386", "i686" };
+        #else
+            return { "x64", "amd64", "win64", "arm64", "aarch64" };
+        #endif
+    }
+};
\ No newline at end of file
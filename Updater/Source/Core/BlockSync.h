@@ -0,0 +1,512 @@
+/*
+  BlockSync.h - zsync-style block synchronisation against local files
+  
+  A release may publish "<asset>.blockmap" next to an asset that is
+  served uncompressed (the plugin binary, or a stored zip). The block
+  map lists a weak rolling checksum and a strong hash for every block
+  of that asset. The updater slides a window over the installed plugin
+  (and its backup) looking for blocks it already has, copies those
+  locally and fetches only the missing byte ranges with HTTP Range.
+  An installed bundle (always the case on macOS) is seeded from the
+  files inside it: a stored zip of the new bundle holds their bytes
+  as they are.
+  
+  Unlike delta patches this works from any earlier version, or from a
+  locally modified install: whatever blocks still match are reused.
+  
+  Block map format (little-endian):
+    
+    "SAMPBMP1"
+    int64  fileSize
+    int32  blockSize
+    uint8  fileSha256[32]
+    per block: uint32 weak, uint8 strong[16]   (strong = SHA-256 prefix)
+  
+  weak = (a & 0xffff) << 16 | (b & 0xffff), with a = sum of the block's
+  bytes and b = sum of (blockSize - i) * byte[i], as in rsync.
+  
+  The last block is hashed as-is (not padded) and always downloaded.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <map>
+#include "../Config.h"
+#include "ReleaseInfo.h"
+#include "GitHubAPI.h"
+#include "NetworkEngine.h"
+#include "ResourceGovernor.h"
+#include "Sha256.h"
+
+class BlockSync
+{
+public:
+    struct BlockMap
+    {
+        juce::int64 fileSize = 0;
+        int blockSize = 0;
+        juce::String fileSha256;
+        juce::Array<juce::uint32> weak;
+        juce::MemoryBlock strong;       // 16 bytes per block
+        
+        int getNumBlocks() const { return weak.size(); }
+        
+        juce::int64 getBlockStart(int index) const { return (juce::int64) index * blockSize; }
+        
+        int getBlockLength(int index) const
+        {
+            return (int) juce::jmin<juce::int64>(blockSize, fileSize - getBlockStart(index));
+        }
+        
+        bool isValid() const
+        {
+            return fileSize > 0 && blockSize > 0 && !weak.isEmpty();
+        }
+    };
+    
+    //==========================================================================
+    // PUBLIC API
+    //==========================================================================
+    
+    /**
+     * Try to assemble the release asset that has a block map from local
+     * seed files plus ranged downloads. On success destinationDir holds
+     * the asset under its own name and that file is returned; otherwise
+     * returns an empty File and the caller downloads the asset normally.
+     */
+    static juce::File tryBuild(const ReleaseInfo& release,
+                               const juce::File& destinationDir,
+                               Downloader::ProgressCallback progressCallback = nullptr)
+    {
+        ReleaseInfo::Asset mapAsset, target;
+        
+        for (auto& asset : release.assets)
+        {
+            if (!isBlockMapAsset(asset.name))
+                continue;
+            
+            // Only the map of the asset chosen for this platform
+            for (auto& other : release.assets)
+            {
+                if (other.downloadUrl == release.downloadUrl
+                    && other.name.equalsIgnoreCase(asset.name.dropLastCharacters(9)))
+                {
+                    mapAsset = asset;
+                    target = other;
+                }
+            }
+        }
+        
+        if (mapAsset.downloadUrl.isEmpty())
+            return {};
+        
+        auto seeds = getSeeds();
+        
+        if (seeds.isEmpty())
+            return {};
+        
+        auto map = fetchBlockMap(mapAsset);
+        
+        if (!map.isValid() || (target.size > 0 && map.fileSize != target.size))
+        {
+            UpdaterConfig::logMessage("Block sync: no usable block map for " + target.name);
+            return {};
+        }
+        
+        // Too small to hold a whole block
+        seeds.removeIf([&map](const juce::File& seed) { return seed.getSize() < map.blockSize; });
+        
+        if (seeds.isEmpty())
+            return {};
+        
+        auto output = destinationDir.getChildFile(target.name);
+        
+        if (build(map, seeds, target.downloadUrl, output, progressCallback))
+            return output;
+        
+        output.deleteFile();
+        UpdaterConfig::logMessage("Block sync failed, falling back to full download");
+        return {};
+    }
+    
+    static bool isBlockMapAsset(const juce::String& name)
+    {
+        return name.endsWithIgnoreCase(".blockmap");
+    }
+    
+    /**
+     * The installed plugin and its backup; a bundle contributes every
+     * file inside it
+     */
+    static juce::Array<juce::File> getSeeds()
+    {
+        juce::Array<juce::File> seeds;
+        
+        for (auto& item : { UpdaterConfig::getPluginInstallPath(), UpdaterConfig::getBackupFile() })
+        {
+            if (item.existsAsFile())
+                seeds.add(item);
+            else if (item.isDirectory())
+                seeds.addArray(item.findChildFiles(juce::File::findFiles, true, "*", juce::File::FollowSymlinks::no));
+        }
+        
+        return seeds;
+    }
+    
+    //==========================================================================
+    // BLOCK MAP
+    //==========================================================================
+    
+    static BlockMap parseBlockMap(const juce::MemoryBlock& data)
+    {
+        BlockMap map;
+        constexpr int headerSize = 8 + 8 + 4 + 32;
+        constexpr int entrySize = 4 + 16;
+        
+        if (data.getSize() < (size_t) headerSize || std::memcmp(data.getData(), "SAMPBMP1", 8) != 0)
+            return map;
+        
+        juce::MemoryInputStream in(data, false);
+        in.skipNextBytes(8);
+        
+        auto fileSize = in.readInt64();
+        auto blockSize = in.readInt();
+        
+        juce::uint8 sha[32];
+        in.read(sha, 32);
+        
+        if (fileSize <= 0 || blockSize < 512)
+            return map;
+        
+        auto numBlocks = (fileSize + blockSize - 1) / blockSize;
+        
+        if ((juce::int64) data.getSize() != headerSize + numBlocks * entrySize)
+            return map;
+        
+        map.strong.setSize((size_t) numBlocks * 16);
+        map.weak.ensureStorageAllocated((int) numBlocks);
+        
+        for (juce::int64 i = 0; i < numBlocks; ++i)
+        {
+            map.weak.add((juce::uint32) in.readInt());
+            in.read(static_cast<char*>(map.strong.getData()) + i * 16, 16);
+        }
+        
+        map.fileSize = fileSize;
+        map.blockSize = blockSize;
+        map.fileSha256 = juce::String::toHexString(sha, 32, 0);
+        return map;
+    }
+
+private:
+    //==========================================================================
+    // ASSEMBLY
+    //==========================================================================
+    
+    struct Span
+    {
+        juce::int64 start = 0;
+        juce::int64 end = 0;    // Exclusive
+    };
+    
+    static bool build(const BlockMap& map,
+                      const juce::Array<juce::File>& seeds,
+                      const juce::String& url,
+                      const juce::File& output,
+                      const Downloader::ProgressCallback& progressCallback)
+    {
+        output.deleteFile();
+        
+        juce::FileOutputStream out(output, 0);
+        
+        if (out.failedToOpen())
+            return false;
+        
+        // Blocks found locally are written straight to their final offset
+        juce::Array<bool> have;
+        have.insertMultiple(0, false, map.getNumBlocks());
+        
+        juce::int64 reused = 0;
+        
+        for (auto& seed : seeds)
+            reused += scanSeed(map, seed, have, out);
+        
+        auto missing = getMissingSpans(map, have);
+        
+        juce::int64 toFetch = 0;
+        
+        for (auto& span : missing)
+            toFetch += span.end - span.start;
+        
+        UpdaterConfig::logMessage("Block sync: " + juce::String(reused) + " bytes reused locally, " +
+                                juce::String(toFetch) + " bytes in " + juce::String(missing.size()) +
+                                " ranges to download");
+        
+        juce::int64 fetched = 0;
+        auto fetchUrl = NetworkEngine::getInstance().resolveRedirects(url);
+        
+        for (auto& span : missing)
+        {
+            if (!fetchSpan(fetchUrl, span, out, fetched, toFetch, progressCallback))
+                return false;
+        }
+        
+        // Make sure the file ends up exactly fileSize long
+        if (!out.setPosition(map.fileSize) || !out.truncate().wasOk())
+            return false;
+        
+        out.flush();
+        
+        if (!out.getStatus().wasOk())
+            return false;
+        
+        // Blocks arrive out of order, so the whole-file check reads the
+        // result back (it was just written; the page cache serves it)
+        auto actual = Sha256::hashFile(output);
+        
+        if (actual != map.fileSha256)
+        {
+            UpdaterConfig::logMessage("ERROR: Block sync result hash mismatch");
+            return false;
+        }
+        
+        UpdaterConfig::logMessage("Block sync complete, SHA-256 verified: " + actual);
+        return true;
+    }
+    
+    /**
+     * Slide a block-sized window over seed, one byte at a time, using the
+     * rolling weak checksum to find candidates and the strong hash to
+     * confirm them. Returns bytes reused.
+     */
+    static juce::int64 scanSeed(const BlockMap& map, const juce::File& seed,
+                                juce::Array<bool>& have, juce::FileOutputStream& out)
+    {
+        juce::MemoryBlock data;
+        
+        if (!seed.loadFileAsData(data))
+            return 0;
+        
+        auto* bytes = static_cast<const juce::uint8*>(data.getData());
+        auto size = (juce::int64) data.getSize();
+        auto blockSize = map.blockSize;
+        
+        // Only full-size blocks are matched; the short tail block is fetched
+        auto fullBlocks = (int) (map.fileSize / blockSize);
+        
+        std::multimap<juce::uint32, int> index;
+        
+        for (int i = 0; i < fullBlocks; ++i)
+            if (!have[i])
+                index.emplace(map.weak[i], i);
+        
+        if (index.empty() || size < blockSize)
+            return 0;
+        
+        juce::int64 reused = 0;
+        RollingChecksum rolling(bytes, blockSize);
+        
+        for (juce::int64 pos = 0; pos + blockSize <= size;)
+        {
+            bool matched = false;
+            auto candidates = index.equal_range(rolling.get());
+            
+            if (candidates.first != candidates.second)
+            {
+                juce::uint8 strong[16];
+                getStrongHash(bytes + pos, blockSize, strong);
+                
+                for (auto it = candidates.first; it != candidates.second;)
+                {
+                    auto block = it->second;
+                    
+                    if (std::memcmp(strong, static_cast<const juce::uint8*>(map.strong.getData()) + block * 16, 16) != 0)
+                    {
+                        ++it;
+                        continue;
+                    }
+                    
+                    if (!out.setPosition(map.getBlockStart(block)) || !out.write(bytes + pos, (size_t) blockSize))
+                        return reused;
+                    
+                    have.set(block, true);
+                    reused += blockSize;
+                    matched = true;
+                    
+                    // Identical blocks in the target are all served by this match
+                    it = index.erase(it);
+                }
+            }
+            
+            if (matched && pos + 2 * (juce::int64) blockSize <= size)
+            {
+                pos += blockSize;
+                rolling = RollingChecksum(bytes + pos, blockSize);
+            }
+            else if (pos + blockSize < size)
+            {
+                rolling.roll(bytes[pos], bytes[pos + blockSize]);
+                ++pos;
+            }
+            else
+            {
+                break;
+            }
+        }
+        
+        return reused;
+    }
+    
+    /**
+     * Coalesce missing blocks into ranges. Small gaps are downloaded
+     * anyway to keep the number of requests down.
+     */
+    static juce::Array<Span> getMissingSpans(const BlockMap& map, const juce::Array<bool>& have)
+    {
+        juce::Array<Span> spans;
+        
+        for (int i = 0; i < map.getNumBlocks(); ++i)
+        {
+            if (have[i])
+                continue;
+            
+            auto start = map.getBlockStart(i);
+            auto end = start + map.getBlockLength(i);
+            
+            if (!spans.isEmpty() && start - spans.getReference(spans.size() - 1).end <= UpdaterConfig::BLOCK_SYNC_MERGE_GAP)
+                spans.getReference(spans.size() - 1).end = end;
+            else
+                spans.add({ start, end });
+        }
+        
+        return spans;
+    }
+    
+    static bool fetchSpan(const juce::String& url, const Span& span, juce::FileOutputStream& out,
+                          juce::int64& fetched, juce::int64 toFetch,
+                          const Downloader::ProgressCallback& progressCallback)
+    {
+        int statusCode = 0;
+        
+        auto stream = juce::URL(url).createInputStream(
+            juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                .withExtraHeaders("Range: bytes=" + juce::String(span.start) + "-" + juce::String(span.end - 1) + "\r\n")
+                .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                .withStatusCode(&statusCode)
+        );
+        
+        if (stream == nullptr || statusCode != 206)
+        {
+            UpdaterConfig::logMessage("ERROR: Block sync range request failed, status " + juce::String(statusCode));
+            return false;
+        }
+        
+        if (!out.setPosition(span.start))
+            return false;
+        
+        juce::HeapBlock<char> buffer(64 * 1024);
+        
+        for (auto remaining = span.end - span.start; remaining > 0;)
+        {
+            if (NetworkEngine::shouldCurrentJobStop())
+                return false;
+            
+            auto numRead = stream->read(buffer.getData(), (int) juce::jmin<juce::int64>(64 * 1024, remaining));
+            
+            if (numRead <= 0)
+                return false;
+            
+            ResourceGovernor::throttle(numRead);
+            
+            if (!out.write(buffer.getData(), (size_t) numRead))
+                return false;
+            
+            remaining -= numRead;
+            fetched += numRead;
+            
+            if (progressCallback)
+                progressCallback(fetched, toFetch);
+        }
+        
+        return true;
+    }
+    
+    //==========================================================================
+    // CHECKSUMS
+    //==========================================================================
+    
+    /**
+     * rsync/zsync weak checksum: a = sum of bytes, b = sum of prefix sums,
+     * both mod 2^16; rolls forward one byte in O(1)
+     */
+    class RollingChecksum
+    {
+    public:
+        RollingChecksum(const juce::uint8* data, int length)
+            : blockLength((juce::uint32) length)
+        {
+            for (int i = 0; i < length; ++i)
+            {
+                a += data[i];
+                b += (juce::uint32) (length - i) * data[i];
+            }
+        }
+        
+        void roll(juce::uint8 out, juce::uint8 in)
+        {
+            a += (juce::uint32) in - out;
+            b += a - blockLength * out;
+        }
+        
+        juce::uint32 get() const { return ((a & 0xffff) << 16) | (b & 0xffff); }
+    
+    private:
+        juce::uint32 blockLength;
+        juce::uint32 a = 0, b = 0;
+    };
+    
+    static void getStrongHash(const void* data, int length, juce::uint8* result)
+    {
+        Sha256 hasher;
+        hasher.update(data, (size_t) length);
+        
+        juce::MemoryBlock digest;
+        digest.loadFromHexString(hasher.finish());
+        std::memcpy(result, digest.getData(), 16);
+    }
+    
+    //==========================================================================
+    
+    static BlockMap fetchBlockMap(const ReleaseInfo::Asset& asset)
+    {
+        int statusCode = 0;
+        
+        auto stream = juce::URL(asset.downloadUrl).createInputStream(
+            juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                .withStatusCode(&statusCode)
+        );
+        
+        if (stream == nullptr || statusCode != 200)
+            return {};
+        
+        juce::MemoryBlock data;
+        stream->readIntoMemoryBlock(data);
+        
+        auto expected = GitHubAPI::parseSha256(asset.digest);
+        
+        if (expected.isNotEmpty())
+        {
+            Sha256 hasher;
+            hasher.update(data.getData(), data.getSize());
+            
+            if (hasher.finish() != expected)
+            {
+                UpdaterConfig::logMessage("ERROR: Block map digest mismatch");
+                return {};
+            }
+        }
+        
+        return parseBlockMap(data);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,355 @@
+/*
+  CopyEngine.h - Copy files and bundle trees without user-space buffers
+  
+  A VST3 bundle is a directory tree. It is copied as follows:
+  - Directories are created first.
+  - Files are handed to a pool, one thread per core, largest first.
+  - Each file is copied inside the kernel: copy_file_range (falling back
+    to sendfile) on Linux, fcopyfile on macOS, CopyFileExW on Windows.
+  - Permissions and timestamps are kept.
+  - Nothing is synced while copying. When every file is written, all
+    files and directories are flushed to disk in one parallel pass,
+    which lets the device batch the writes.
+  
+  While a DAW is running a single thread is used, like the rest of the
+  updater's background work.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include "../Config.h"
+#include "ResourceGovernor.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+#else
+ #include <cerrno>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/stat.h>
+ #if JUCE_LINUX
+  #include <sys/sendfile.h>
+ #elif JUCE_MAC
+  #include <copyfile.h>
+ #endif
+#endif
+
+class CopyEngine
+{
+public:
+    /**
+     * Copies one file to a path that must not exist. Called on pool threads.
+     */
+    using FileCopier = std::function<bool(const juce::File& source, const juce::File& target)>;
+    
+    /**
+     * Copy source (file or directory tree) to target, which must not
+     * exist, and flush it to disk. copier does each file (copyFile if
+     * not given); numThreads <= 0 uses COPY_THREADS (0 there = one per
+     * core). On failure target is removed.
+     */
+    static bool copyItem(const juce::File& source, const juce::File& target,
+                         FileCopier copier = nullptr, int numThreads = 0)
+    {
+        if (copier == nullptr)
+            copier = copyFile;
+        
+        auto startMs = juce::Time::getMillisecondCounterHiRes();
+        juce::Array<juce::File> dirs, sources, targets;
+        
+        if (source.isDirectory())
+        {
+            dirs.add(target);
+            
+            for (auto& dir : source.findChildFiles(juce::File::findDirectories, true, "*",
+                                                   juce::File::FollowSymlinks::no))
+                dirs.add(target.getChildFile(dir.getRelativePathFrom(source)));
+            
+            sources = source.findChildFiles(juce::File::findFiles, true, "*", juce::File::FollowSymlinks::no);
+            
+            // Largest first, so a big binary doesn't start last
+            std::sort(sources.begin(), sources.end(), [](const juce::File& a, const juce::File& b)
+            {
+                return a.getSize() > b.getSize();
+            });
+            
+            for (auto& file : sources)
+                targets.add(target.getChildFile(file.getRelativePathFrom(source)));
+        }
+        else
+        {
+            sources.add(source);
+            targets.add(target);
+        }
+        
+        for (auto& dir : dirs)
+        {
+            if (!dir.createDirectory())
+                return fail(target);
+        }
+        
+        auto threads = getThreadCount(numThreads, sources.size());
+        std::atomic<bool> failed { false };
+        juce::int64 totalBytes = 0;
+        
+        for (auto& file : sources)
+            totalBytes += file.getSize();
+        
+        {
+            juce::ThreadPool pool(threads);
+            
+            runAll(pool, sources.size(), [&](int i)
+            {
+                if (!failed && !copier(sources.getReference(i), targets.getReference(i)))
+                {
+                    UpdaterConfig::logMessage("ERROR: Failed to copy " + sources.getReference(i).getFullPathName());
+                    failed = true;
+                }
+            });
+            
+            if (failed)
+                return fail(target);
+            
+            // Directory times last: adding files above changed them
+            for (int i = 1; i < dirs.size(); ++i)
+                copyTimes(source.getChildFile(dirs.getReference(i).getRelativePathFrom(target)), dirs.getReference(i));
+            
+            if (source.isDirectory())
+                copyTimes(source, target);
+            
+            // One batch of flushes once everything is written
+            auto toSync = targets;
+            toSync.addArray(dirs);
+            toSync.add(target.getParentDirectory());
+            
+            runAll(pool, toSync.size(), [&](int i)
+            {
+                if (!syncToDisk(toSync.getReference(i)))
+                    failed = true;
+            });
+        }
+        
+        if (failed)
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to flush " + target.getFullPathName());
+            return fail(target);
+        }
+        
+        auto ms = juce::Time::getMillisecondCounterHiRes() - startMs;
+        
+        UpdaterConfig::logMessage("Copied " + juce::String(sources.size()) + " files (" +
+                                juce::String(totalBytes) + " bytes) in " + juce::String(juce::roundToInt(ms)) +
+                                " ms on " + juce::String(threads) + " thread(s), " +
+                                juce::String(totalBytes / 1048576.0 / juce::jmax(0.001, ms / 1000.0), 1) + " MB/s");
+        return true;
+    }
+    
+    /**
+     * Copy one file to a path that must not exist, in the kernel where
+     * the OS allows, keeping its permissions and timestamps. Not synced.
+     */
+    static bool copyFile(const juce::File& source, const juce::File& target)
+    {
+        #if JUCE_WINDOWS
+            // Copied by the OS (server-side on shares); attributes and times come along
+            return CopyFileExW(source.getFullPathName().toWideCharPointer(),
+                               target.getFullPathName().toWideCharPointer(),
+                               nullptr, nullptr, nullptr, COPY_FILE_FAIL_IF_EXISTS) != 0;
+
+        #elif JUCE_LINUX || JUCE_MAC
+            auto in = open(source.getFullPathName().toRawUTF8(), O_RDONLY | O_CLOEXEC);
+            
+            if (in < 0)
+                return false;
+            
+            struct stat info {};
+            
+            auto out = fstat(in, &info) == 0
+                     ? open(target.getFullPathName().toRawUTF8(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                            info.st_mode & 07777)
+                     : -1;
+            
+            bool ok = out >= 0 && copyData(in, out, (juce::int64) info.st_size);
+            
+            if (ok)
+            {
+                // The umask may have narrowed the mode at open()
+                fchmod(out, info.st_mode & 07777);
+
+                #if JUCE_MAC
+                    struct timespec times[2] = { info.st_atimespec, info.st_mtimespec };
+                #else
+                    struct timespec times[2] = { info.st_atim, info.st_mtim };
+                #endif
+
+                futimens(out, times);
+            }
+            
+            if (out >= 0)
+                ok = close(out) == 0 && ok;
+            
+            close(in);
+            
+            if (!ok && out >= 0)
+                unlink(target.getFullPathName().toRawUTF8());
+            
+            return ok;
+
+        #else
+            return source.copyFileTo(target);
+        #endif
+    }
+    
+    /**
+     * Flush a file or directory (its entries) to disk
+     */
+    static bool syncToDisk(const juce::File& item)
+    {
+        #if JUCE_WINDOWS
+            // Directories can't be flushed on Windows; their entries are journaled by NTFS
+            if (item.isDirectory())
+                return true;
+            
+            auto handle = CreateFileW(item.getFullPathName().toWideCharPointer(), GENERIC_WRITE,
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            
+            if (handle == INVALID_HANDLE_VALUE)
+                return false;
+            
+            bool ok = FlushFileBuffers(handle) != 0;
+            CloseHandle(handle);
+            return ok;
+
+        #else
+            auto fd = open(item.getFullPathName().toRawUTF8(), O_RDONLY | O_CLOEXEC);
+            
+            if (fd < 0)
+                return false;
+            
+            // EINVAL: the filesystem doesn't sync directories, nothing to do
+            bool ok = fsync(fd) == 0 || errno == EINVAL;
+            close(fd);
+            return ok;
+        #endif
+    }
+
+    /**
+     * Run task(0 .. count-1) in parallel, on as many threads as copyItem
+     * would use, and wait for all of them
+     */
+    static void forEach(int count, const std::function<void(int)>& task, int numThreads = 0)
+    {
+        juce::ThreadPool pool(getThreadCount(numThreads, count));
+        runAll(pool, count, task);
+    }
+
+private:
+    static int getThreadCount(int requested, int numFiles)
+    {
+        return ResourceGovernor::getThreadCount(requested > 0 ? requested : UpdaterConfig::COPY_THREADS, numFiles);
+    }
+    
+    /**
+     * Run task(0 .. count-1) on pool and wait for all of them
+     */
+    static void runAll(juce::ThreadPool& pool, int count, const std::function<void(int)>& task)
+    {
+        if (count == 0)
+            return;
+        
+        // Shared with the jobs: the last one may still be inside signal() when wait() returns
+        struct Batch
+        {
+            std::atomic<int> remaining { 0 };
+            juce::WaitableEvent done;
+        };
+        
+        auto batch = std::make_shared<Batch>();
+        batch->remaining = count;
+        
+        for (int i = 0; i < count; ++i)
+        {
+            pool.addJob([batch, &task, i]
+            {
+                ResourceGovernor::ScopedBackgroundWork governed(ResourceGovernor::ThreadLife::perPass);
+                task(i);
+                
+                if (--batch->remaining == 0)
+                    batch->done.signal();
+            });
+        }
+        
+        batch->done.wait();
+    }
+    
+    static bool fail(const juce::File& target)
+    {
+        target.deleteRecursively();
+        return false;
+    }
+    
+    static void copyTimes(const juce::File& source, const juce::File& target)
+    {
+        target.setLastModificationTime(source.getLastModificationTime());
+        target.setLastAccessTime(source.getLastAccessTime());
+    }
+
+    #if JUCE_LINUX || JUCE_MAC
+    /**
+     * size bytes from in to out, both at offset 0
+     */
+    static bool copyData(int in, int out, juce::int64 size)
+    {
+        #if JUCE_MAC
+            juce::ignoreUnused(size);
+            return fcopyfile(in, out, nullptr, COPYFILE_DATA) == 0;
+
+        #else
+            juce::int64 done = 0;
+            bool useCopyRange = true;
+            
+            while (done < size)
+            {
+                auto chunk = (size_t) juce::jmin<juce::int64>(size - done, 1 << 30);
+                ssize_t n = -1;
+                
+                if (useCopyRange)
+                {
+                    n = copy_file_range(in, nullptr, out, nullptr, chunk, 0);
+                    
+                    // Old kernel, or a pair of filesystems it won't do: sendfile can
+                    if (n < 0 && done == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL
+                                               || errno == EOPNOTSUPP))
+                    {
+                        useCopyRange = false;
+                        continue;
+                    }
+                }
+                else
+                {
+                    n = sendfile(out, in, nullptr, chunk);
+                }
+                
+                if (n < 0 && errno == EINTR)
+                    continue;
+                
+                // 0: the file shrank while being copied
+                if (n <= 0)
+                    return false;
+                
+                done += n;
+            }
+            
+            return true;
+        #endif
+    }
+    #endif
+};
\ No newline at end of file
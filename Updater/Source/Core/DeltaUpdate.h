@@ -0,0 +1,380 @@
+/*
+  DeltaUpdate.h - Rebuild the new plugin binary from the installed one
+  
+  Releases may ship patch assets next to the full download, named
+  "<anything>.from-<key>.patch" where key is the from-version
+  (e.g. "2.0.0") or a hex prefix of the from-binary's SHA-256.
+  The updater hashes the installed binary, picks the patch built
+  against exactly those bytes and applies it locally. Any mismatch
+  falls back to the full asset.
+  
+  Only single-file installs (the Windows .vst3 file) are patched. A
+  bundle (always the case on macOS) holds more than the binary a
+  patch rebuilds, so it goes through block sync or the full download.
+  
+  Patch format (bsdiff semantics; zlib instead of bzip2 so it can be
+  read with JUCE alone). All integers are little-endian int64.
+    
+    "SAMPDLT1"
+    sourceSize, sourceSha256[32]
+    targetSize, targetSha256[32]
+    controlLength, diffLength, extraLength    (compressed sizes)
+    control block  zlib( (addLength, copyLength, seek) ... )
+    diff block     zlib( bytes added to source bytes )
+    extra block    zlib( bytes copied verbatim )
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "ReleaseInfo.h"
+#include "GitHubAPI.h"
+#include "Sha256.h"
+
+class DeltaUpdate
+{
+public:
+    struct Header
+    {
+        juce::int64 sourceSize = -1;
+        juce::String sourceSha256;
+        juce::int64 targetSize = -1;
+        juce::String targetSha256;
+        juce::int64 controlLength = 0;
+        juce::int64 diffLength = 0;
+        juce::int64 extraLength = 0;
+        
+        bool isValid() const
+        {
+            return sourceSize >= 0 && targetSize >= 0
+                && controlLength >= 0 && diffLength >= 0 && extraLength >= 0;
+        }
+    };
+    
+    static constexpr int headerSize = 8 + 8 + 32 + 8 + 32 + 3 * 8;
+    
+    //==========================================================================
+    // PUBLIC API
+    //==========================================================================
+    
+    /**
+     * Try to produce the release's plugin binary at destination from the
+     * installed one. Returns false (leaving nothing behind) if there is no
+     * matching patch or anything about it doesn't check out; the caller
+     * then downloads the full asset.
+     */
+    static bool tryBuild(const ReleaseInfo& release,
+                         const juce::File& destination,
+                         Downloader::ProgressCallback progressCallback = nullptr)
+    {
+        auto installed = UpdaterConfig::getPluginInstallPath();
+        
+        if (!installed.existsAsFile())
+        {
+            if (installed.isDirectory())
+                UpdaterConfig::logMessage("Delta patches only apply to single-file installs, skipping");
+            
+            return false;
+        }
+        
+        juce::Array<ReleaseInfo::Asset> patches;
+        
+        for (auto& asset : release.assets)
+            if (GitHubAPI::isPatchAsset(asset.name))
+                patches.add(asset);
+        
+        if (patches.isEmpty())
+            return false;
+        
+        auto sourceSha256 = Sha256::hashFile(installed);
+        
+        if (sourceSha256.isEmpty())
+            return false;
+        
+        auto patch = findPatchFor(patches, sourceSha256);
+        
+        if (patch.downloadUrl.isEmpty())
+        {
+            UpdaterConfig::logMessage("No delta patch matches the installed binary, using full download");
+            return false;
+        }
+        
+        UpdaterConfig::logMessage("Delta update: " + patch.name + " (" +
+                                juce::String(patch.size) + " bytes instead of full asset)");
+        
+        auto patchFile = destination.getSiblingFile(destination.getFileName() + ".patch");
+        
+        bool ok = GitHubAPI::downloadFile(patch.downloadUrl, patchFile, std::move(progressCallback),
+                                          GitHubAPI::parseSha256(patch.digest), patch.size > 0 ? patch.size : -1,
+                                          GitHubAPI::getMirrorUrls(release, patch.downloadUrl))
+               && apply(patchFile, installed, destination);
+        
+        patchFile.deleteFile();
+        
+        if (!ok)
+        {
+            UpdaterConfig::logMessage("Delta update failed, falling back to full download");
+            destination.deleteFile();
+        }
+        
+        return ok;
+    }
+    
+    //==========================================================================
+    // PATCH FORMAT
+    //==========================================================================
+    
+    static Header readHeader(const void* data, size_t size)
+    {
+        Header h;
+        
+        if (size < (size_t) headerSize || std::memcmp(data, "SAMPDLT1", 8) != 0)
+            return h;
+        
+        juce::MemoryInputStream in(data, size, false);
+        in.skipNextBytes(8);
+        
+        auto readSha = [&in]
+        {
+            juce::uint8 digest[32];
+            in.read(digest, 32);
+            return juce::String::toHexString(digest, 32, 0);
+        };
+        
+        Header parsed;
+        parsed.sourceSize = in.readInt64();
+        parsed.sourceSha256 = readSha();
+        parsed.targetSize = in.readInt64();
+        parsed.targetSha256 = readSha();
+        parsed.controlLength = in.readInt64();
+        parsed.diffLength = in.readInt64();
+        parsed.extraLength = in.readInt64();
+        
+        auto blocks = (juce::uint64) parsed.controlLength + (juce::uint64) parsed.diffLength
+                    + (juce::uint64) parsed.extraLength;
+        
+        // Blocks may be absent when only the header was fetched
+        if (!parsed.isValid() || (size > (size_t) headerSize && headerSize + blocks != size))
+            return h;
+        
+        return parsed;
+    }
+    
+    /**
+     * Apply patchFile to sourceFile, writing targetFile.
+     * The output is hashed as it is written and must match the target
+     * digest recorded in the patch.
+     */
+    static bool apply(const juce::File& patchFile, const juce::File& sourceFile, const juce::File& targetFile)
+    {
+        juce::MemoryBlock patch, source;
+        
+        if (!patchFile.loadFileAsData(patch) || !sourceFile.loadFileAsData(source))
+            return false;
+        
+        auto header = readHeader(patch.getData(), patch.getSize());
+        
+        if (!header.isValid() || patch.getSize() == (size_t) headerSize)
+        {
+            UpdaterConfig::logMessage("ERROR: Invalid delta patch");
+            return false;
+        }
+        
+        Sha256 sourceHasher;
+        sourceHasher.update(source.getData(), source.getSize());
+        
+        if ((juce::int64) source.getSize() != header.sourceSize
+            || sourceHasher.finish() != header.sourceSha256)
+        {
+            UpdaterConfig::logMessage("ERROR: Delta patch was built for a different binary");
+            return false;
+        }
+        
+        targetFile.deleteFile();
+        bool ok = false;
+        
+        {
+            juce::FileOutputStream out(targetFile);
+            ok = !out.failedToOpen() && writeTarget(header, patch, source, out);
+        }
+        
+        if (!ok)
+            targetFile.deleteFile();
+        
+        return ok;
+    }
+
+private:
+    static constexpr int chunkSize = 64 * 1024;
+    
+    //==========================================================================
+    // PATCHING
+    //==========================================================================
+    
+    static bool writeTarget(const Header& header,
+                            const juce::MemoryBlock& patch,
+                            const juce::MemoryBlock& source,
+                            juce::FileOutputStream& out)
+    {
+        auto* base = static_cast<const char*>(patch.getData()) + headerSize;
+        
+        auto control = openBlock(base, header.controlLength);
+        auto diff = openBlock(base + header.controlLength, header.diffLength);
+        auto extra = openBlock(base + header.controlLength + header.diffLength, header.extraLength);
+        
+        auto* old = static_cast<const juce::uint8*>(source.getData());
+        auto oldSize = (juce::int64) source.getSize();
+        
+        juce::HeapBlock<juce::uint8> buffer(chunkSize);
+        Sha256 hasher;
+        juce::int64 newPos = 0, oldPos = 0;
+        
+        auto emit = [&](juce::int64 numBytes, juce::InputStream& from, bool addSource)
+        {
+            while (numBytes > 0)
+            {
+                auto n = (int) juce::jmin<juce::int64>(chunkSize, numBytes);
+                
+                if (from.read(buffer.getData(), n) != n)
+                    return false;
+                
+                if (addSource)
+                {
+                    for (int i = 0; i < n; ++i)
+                        if (oldPos + i >= 0 && oldPos + i < oldSize)
+                            buffer[i] = (juce::uint8) (buffer[i] + old[oldPos + i]);
+                    
+                    oldPos += n;
+                }
+                
+                hasher.update(buffer.getData(), (size_t) n);
+                
+                if (!out.write(buffer.getData(), (size_t) n))
+                    return false;
+                
+                newPos += n;
+                numBytes -= n;
+            }
+            
+            return true;
+        };
+        
+        while (newPos < header.targetSize)
+        {
+            juce::int64 triple[3];
+            
+            for (auto& value : triple)
+            {
+                juce::uint8 bytes[8];
+                
+                if (control->read(bytes, 8) != 8)
+                    return fail("truncated control block");
+                
+                value = (juce::int64) juce::ByteOrder::littleEndianInt64(bytes);
+            }
+            
+            auto addLength = triple[0], copyLength = triple[1], seek = triple[2];
+            
+            if (addLength < 0 || copyLength < 0 || newPos + addLength + copyLength > header.targetSize)
+                return fail("corrupt control block");
+            
+            if (!emit(addLength, *diff, true) || !emit(copyLength, *extra, false))
+                return fail("truncated data block");
+            
+            oldPos += seek;
+        }
+        
+        out.flush();
+        
+        if (!out.getStatus().wasOk())
+            return fail("write failed");
+        
+        auto actual = hasher.finish();
+        
+        if (actual != header.targetSha256)
+            return fail("result hash mismatch");
+        
+        UpdaterConfig::logMessage("Delta patch applied, SHA-256 verified: " + actual);
+        return true;
+    }
+    
+    //==========================================================================
+    // PATCH SELECTION
+    //==========================================================================
+    
+    /**
+     * Prefer a patch whose name carries a hash prefix of the installed
+     * binary; otherwise read the header of each version-keyed patch
+     * (one small Range request each) and compare source hashes.
+     */
+    static ReleaseInfo::Asset findPatchFor(const juce::Array<ReleaseInfo::Asset>& patches,
+                                           const juce::String& sourceSha256)
+    {
+        for (auto& patch : patches)
+        {
+            auto key = getPatchKey(patch.name);
+            
+            if (key.length() >= 8 && key.containsOnly("0123456789abcdefABCDEF")
+                && sourceSha256.startsWithIgnoreCase(key))
+                return patch;
+        }
+        
+        for (auto& patch : patches)
+        {
+            auto header = fetchHeader(patch.downloadUrl);
+            
+            if (header.isValid() && header.sourceSha256 == sourceSha256)
+                return patch;
+        }
+        
+        return {};
+    }
+    
+    /**
+     * "samp-2.0.1.from-2.0.0.patch" -> "2.0.0"
+     */
+    static juce::String getPatchKey(const juce::String& name)
+    {
+        return name.fromLastOccurrenceOf(".from-", false, true)
+                   .upToLastOccurrenceOf(".patch", false, true);
+    }
+    
+    static Header fetchHeader(const juce::String& url)
+    {
+        int statusCode = 0;
+        
+        auto stream = juce::URL(NetworkEngine::getInstance().resolveRedirects(url)).createInputStream(
+            juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                .withExtraHeaders("Range: bytes=0-" + juce::String(headerSize - 1) + "\r\n")
+                .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                .withStatusCode(&statusCode)
+        );
+        
+        if (stream == nullptr || (statusCode != 206 && statusCode != 200))
+            return {};
+        
+        char bytes[headerSize];
+        
+        if (stream->read(bytes, headerSize) != headerSize)
+            return {};
+        
+        return readHeader(bytes, (size_t) headerSize);
+    }
+    
+    //==========================================================================
+    // HELPERS
+    //==========================================================================
+    
+    static std::unique_ptr<juce::InputStream> openBlock(const char* data, juce::int64 length)
+    {
+        return std::make_unique<juce::GZIPDecompressorInputStream>(
+            new juce::MemoryInputStream(data, (size_t) length, false), true,
+            juce::GZIPDecompressorInputStream::zlibFormat);
+    }
+    
+    static bool fail(const juce::String& reason)
+    {
+        UpdaterConfig::logMessage("ERROR: Delta patch " + reason);
+        return false;
+    }
+};
\ No newline at end of file
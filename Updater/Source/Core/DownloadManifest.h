@@ -0,0 +1,163 @@
+/*
+  DownloadManifest.h - Sidecar state for resumable downloads
+  
+  Stored next to the partial file as "<name>.part.xml". Records which
+  asset the partial bytes belong to (URL + validator + size) and how far
+  each byte range has been durably written, so an interrupted download
+  can continue with Range requests instead of starting from zero.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+
+class DownloadManifest
+{
+public:
+    struct Range
+    {
+        juce::int64 start = 0;      // First byte (inclusive)
+        juce::int64 end = 0;        // Last byte (exclusive)
+        juce::int64 position = 0;   // Next byte to fetch (all before it are on disk)
+        
+        bool isComplete() const { return position >= end; }
+    };
+    
+    juce::String url;               // Asset URL
+    juce::String etag;              // ETag of the asset when download started
+    juce::String lastModified;      // Last-Modified, used if there is no ETag
+    juce::int64 expectedSize = -1;  // Full asset size
+    juce::Array<Range> ranges;      // Byte ranges and their progress
+    
+    //==========================================================================
+    
+    /**
+     * Validator to send with If-Range (empty if the asset can't be validated)
+     */
+    juce::String getValidator() const
+    {
+        return etag.isNotEmpty() ? etag : lastModified;
+    }
+    
+    /**
+     * Bytes already written and flushed
+     */
+    juce::int64 getVerifiedBytes() const
+    {
+        juce::int64 total = 0;
+        
+        for (auto& r : ranges)
+            total += r.position - r.start;
+        
+        return total;
+    }
+    
+    bool isComplete() const
+    {
+        for (auto& r : ranges)
+            if (!r.isComplete())
+                return false;
+        
+        return !ranges.isEmpty();
+    }
+    
+    /**
+     * True if this manifest describes the same, unchanged asset
+     */
+    bool matches(const juce::String& otherUrl,
+                 const juce::String& otherEtag,
+                 const juce::String& otherLastModified,
+                 juce::int64 otherSize) const
+    {
+        if (url != otherUrl || expectedSize != otherSize || getValidator().isEmpty())
+            return false;
+        
+        return etag.isNotEmpty() ? (etag == otherEtag)
+                                 : (lastModified == otherLastModified);
+    }
+    
+    /**
+     * Split [0, size) into numRanges equal ranges, last one takes the remainder
+     */
+    void split(juce::int64 size, int numRanges)
+    {
+        ranges.clearQuick();
+        expectedSize = size;
+        
+        auto rangeSize = size / numRanges;
+        
+        for (int i = 0; i < numRanges; ++i)
+        {
+            Range r;
+            r.start = i * rangeSize;
+            r.end = (i == numRanges - 1) ? size : r.start + rangeSize;
+            r.position = r.start;
+            ranges.add(r);
+        }
+    }
+    
+    //==========================================================================
+    // PERSISTENCE
+    //==========================================================================
+    
+    static juce::File getFileFor(const juce::File& partFile)
+    {
+        return partFile.getSiblingFile(partFile.getFileName() + ".xml");
+    }
+    
+    static DownloadManifest load(const juce::File& file)
+    {
+        DownloadManifest manifest;
+        auto xml = juce::parseXML(file);
+        
+        if (xml == nullptr || !xml->hasTagName("DownloadManifest"))
+            return manifest;
+        
+        manifest.url = xml->getStringAttribute("url");
+        manifest.etag = xml->getStringAttribute("etag");
+        manifest.lastModified = xml->getStringAttribute("lastModified");
+        manifest.expectedSize = xml->getStringAttribute("expectedSize", "-1").getLargeIntValue();
+        
+        for (auto* e : xml->getChildWithTagNameIterator("Range"))
+        {
+            Range r;
+            r.start = e->getStringAttribute("start").getLargeIntValue();
+            r.end = e->getStringAttribute("end").getLargeIntValue();
+            r.position = e->getStringAttribute("position").getLargeIntValue();
+            
+            // Reject anything inconsistent rather than splice garbage
+            if (r.start > r.position || r.position > r.end)
+                return DownloadManifest();
+            
+            manifest.ranges.add(r);
+        }
+        
+        return manifest;
+    }
+    
+    /**
+     * Write atomically (temp file + rename) so a crash never leaves
+     * a manifest claiming more than is on disk
+     */
+    bool save(const juce::File& file) const
+    {
+        juce::XmlElement xml("DownloadManifest");
+        xml.setAttribute("url", url);
+        xml.setAttribute("etag", etag);
+        xml.setAttribute("lastModified", lastModified);
+        xml.setAttribute("expectedSize", juce::String(expectedSize));
+        xml.setAttribute("verifiedBytes", juce::String(getVerifiedBytes()));
+        
+        for (auto& r : ranges)
+        {
+            auto* e = xml.createNewChildElement("Range");
+            e->setAttribute("start", juce::String(r.start));
+            e->setAttribute("end", juce::String(r.end));
+            e->setAttribute("position", juce::String(r.position));
+        }
+        
+        juce::TemporaryFile temp(file);
+        
+        return xml.writeTo(temp.getFile())
+            && temp.overwriteTargetFileWithTemporary();
+    }
+};
\ No newline at end of file
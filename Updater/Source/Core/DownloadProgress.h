@@ -0,0 +1,153 @@
+/*
+  DownloadProgress.h - Lock-free progress channel for downloads
+  
+  The download thread only stores two 64-bit counters; the UI polls
+  them on a timer and derives throughput and ETA on its own side.
+  Nothing is posted to the message queue from the transfer loop.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+
+class DownloadProgress
+{
+public:
+    //==========================================================================
+    // WRITER SIDE (download thread)
+    //==========================================================================
+    
+    /**
+     * Start a new transfer (total -1 if unknown)
+     */
+    void begin(juce::int64 totalBytes = -1)
+    {
+        bytesDone.store(0, std::memory_order_relaxed);
+        total.store(totalBytes, std::memory_order_relaxed);
+        startMs.store(juce::Time::getMillisecondCounterHiRes(), std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    
+    void update(juce::int64 bytesDownloaded, juce::int64 totalBytes)
+    {
+        total.store(totalBytes, std::memory_order_relaxed);
+        bytesDone.store(bytesDownloaded, std::memory_order_relaxed);
+    }
+    
+    //==========================================================================
+    // READER SIDE (UI timer)
+    //==========================================================================
+    
+    struct Snapshot
+    {
+        juce::int64 bytesDone = 0;
+        juce::int64 totalBytes = -1;     // -1 if unknown
+        double currentBytesPerSec = 0.0; // Smoothed over the last few polls
+        double averageBytesPerSec = 0.0; // Since begin()
+        double secondsRemaining = -1.0;  // -1 if unknown
+        
+        double getProgress() const
+        {
+            return totalBytes > 0 ? juce::jlimit(0.0, 1.0, (double) bytesDone / (double) totalBytes)
+                                  : 0.0;
+        }
+        
+        /**
+         * e.g. "12.4 MB of 40.0 MB - 2.1 MB/s - 0:13 left"
+         */
+        juce::String toString() const
+        {
+            juce::String text = formatBytes(bytesDone);
+            
+            if (totalBytes > 0)
+                text << " of " << formatBytes(totalBytes);
+            
+            if (currentBytesPerSec > 0.0)
+                text << " - " << formatBytes((juce::int64) currentBytesPerSec) << "/s";
+            
+            if (secondsRemaining >= 0.0)
+            {
+                auto secs = (int) std::ceil(secondsRemaining);
+                text << " - " << (secs / 60) << ":" << juce::String(secs % 60).paddedLeft('0', 2) << " left";
+            }
+            
+            return text;
+        }
+        
+        static juce::String formatBytes(juce::int64 bytes)
+        {
+            if (bytes < 1024)
+                return juce::String(bytes) + " B";
+            else if (bytes < 1024 * 1024)
+                return juce::String(bytes / 1024.0, 1) + " KB";
+            else
+                return juce::String(bytes / (1024.0 * 1024.0), 1) + " MB";
+        }
+    };
+    
+    /**
+     * Turns raw counters into rates. Owned by the single reader, so the
+     * smoothing state never has to be shared with the download thread.
+     */
+    class Meter
+    {
+    public:
+        Snapshot poll(const DownloadProgress& progress)
+        {
+            Snapshot s;
+            s.bytesDone = progress.bytesDone.load(std::memory_order_relaxed);
+            s.totalBytes = progress.total.load(std::memory_order_relaxed);
+            
+            auto now = juce::Time::getMillisecondCounterHiRes();
+            auto gen = progress.generation.load(std::memory_order_acquire);
+            
+            // New transfer: start measuring from here, so bytes restored
+            // by a resume don't show up as a burst of speed
+            if (gen != lastGeneration || s.bytesDone < lastBytes)
+            {
+                lastGeneration = gen;
+                lastBytes = s.bytesDone;
+                lastMs = now;
+                smoothedRate = 0.0;
+            }
+            
+            auto elapsedSec = (now - progress.startMs.load(std::memory_order_relaxed)) / 1000.0;
+            
+            if (elapsedSec > 0.0)
+                s.averageBytesPerSec = (double) s.bytesDone / elapsedSec;
+            
+            auto intervalSec = (now - lastMs) / 1000.0;
+            
+            if (intervalSec >= 0.05)
+            {
+                auto rate = (double) (s.bytesDone - lastBytes) / intervalSec;
+                
+                // Exponential smoothing, ~1 s time constant at UI poll rates
+                auto alpha = juce::jmin(1.0, intervalSec);
+                smoothedRate = smoothedRate <= 0.0 ? rate : smoothedRate + alpha * (rate - smoothedRate);
+                
+                lastBytes = s.bytesDone;
+                lastMs = now;
+            }
+            
+            s.currentBytesPerSec = smoothedRate;
+            
+            if (s.totalBytes > 0 && smoothedRate > 1.0)
+                s.secondsRemaining = (double) juce::jmax<juce::int64>(0, s.totalBytes - s.bytesDone) / smoothedRate;
+            
+            return s;
+        }
+    
+    private:
+        juce::uint32 lastGeneration = 0;
+        juce::int64 lastBytes = 0;
+        double lastMs = 0.0;
+        double smoothedRate = 0.0;
+    };
+
+private:
+    std::atomic<juce::int64> bytesDone { 0 };
+    std::atomic<juce::int64> total { -1 };
+    std::atomic<double> startMs { 0.0 };
+    std::atomic<juce::uint32> generation { 0 };
+};
\ No newline at end of file
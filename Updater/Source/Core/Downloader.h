@@ -0,0 +1,1165 @@
+/*
+  Downloader.h - Segmented, resumable HTTP downloads
+  
+  Handles:
+  - Probing the server for byte-range support
+  - Fetching N byte ranges in parallel (on the shared transfer pool)
+  - Resuming partial downloads (sidecar manifest + If-Range)
+  - Falling back to a single stream when ranges are not supported
+  - Racing mirrors for the fastest source, and switching source
+    mid-download when one stalls or drops (ranges continue where
+    they are; nothing is restarted)
+  - Hashing bytes as they arrive and checking size + SHA-256 before
+    the file is handed on
+  - Streaming the body into a consumer (e.g. an archive extractor)
+    while the connection reads ahead, with no file in between
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <deque>
+#include "../Config.h"
+#include "DownloadManifest.h"
+#include "MirrorSelector.h"
+#include "NetworkEngine.h"
+#include "ResourceGovernor.h"
+#include "Sha256.h"
+
+class Downloader
+{
+public:
+    /**
+     * progressCallback: void(int64 bytesDownloaded, int64 totalBytes)
+     * Called from the download thread; keep it cheap (e.g. store to atomics).
+     */
+    using ProgressCallback = std::function<void(juce::int64, juce::int64)>;
+    
+    /**
+     * Reads the body from the stream it is given; returns false on failure
+     */
+    using StreamConsumer = std::function<bool(juce::InputStream&)>;
+    
+    //==========================================================================
+    // PROBE
+    //==========================================================================
+    
+    struct ProbeResult
+    {
+        bool ok = false;                // Server answered at all
+        bool acceptsRanges = false;     // "Accept-Ranges: bytes"
+        juce::int64 contentLength = -1; // -1 if unknown
+        juce::String etag;              // Validator for resume
+        juce::String lastModified;      // Fallback validator
+    };
+    
+    /**
+     * HEAD request (redirects followed) to learn size, range support and validators
+     */
+    static ProbeResult probe(const juce::String& url)
+    {
+        ProbeResult result;
+        
+        juce::StringPairArray headers;
+        int statusCode = 0;
+        
+        auto stream = juce::URL(url).createInputStream(
+            juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                .withHttpRequestCmd("HEAD")
+                .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                .withResponseHeaders(&headers)
+                .withStatusCode(&statusCode)
+        );
+        
+        if (stream == nullptr || statusCode != 200)
+            return result;
+        
+        result.ok = true;
+        result.acceptsRanges = headers.getValue("Accept-Ranges", {}).containsIgnoreCase("bytes");
+        result.contentLength = headers.getValue("Content-Length", "-1").getLargeIntValue();
+        result.etag = headers.getValue("ETag", {});
+        result.lastModified = headers.getValue("Last-Modified", {});
+        
+        return result;
+    }
+    
+    //==========================================================================
+    
+    Downloader(const juce::String& sourceUrl,
+               const juce::File& destinationFile,
+               int numSegments,
+               ProgressCallback callback = nullptr)
+        : url(sourceUrl),
+          destination(destinationFile),
+          partFile(destinationFile.getSiblingFile(destinationFile.getFileName() + ".part")),
+          manifestFile(DownloadManifest::getFileFor(partFile)),
+          segmentCount(juce::jmax(1, numSegments)),
+          progressCallback(std::move(callback))
+    {
+    }
+    
+    /**
+     * Published size / SHA-256 (hex) the download must match.
+     * Empty digest or size < 0 skips that check.
+     */
+    void setExpected(const juce::String& sha256Hex, juce::int64 size)
+    {
+        expectedSha256 = sha256Hex.trim().toLowerCase();
+        expectedSize = size;
+    }
+    
+    /**
+     * Other URLs serving the same bytes. They are raced against the
+     * asset URL, and used for failover once a digest is set (bytes
+     * from different servers are only spliced when the result is hashed).
+     */
+    void setMirrors(const juce::StringArray& mirrorUrls)
+    {
+        mirrors = mirrorUrls;
+        mirrors.removeString(url);
+    }
+    
+    /**
+     * Run download on the calling thread
+     * Returns: true if the whole file was written to destination.
+     * On failure the partial file is kept so the next run can resume.
+     */
+    bool run()
+    {
+        UpdaterConfig::logMessage("Downloading: " + url);
+        UpdaterConfig::logMessage("To: " + destination.getFullPathName());
+        
+        selectSource();
+        auto info = probe(getSource().url);
+        
+        if (info.acceptsRanges && info.contentLength > 0)
+        {
+            auto result = runRanged(info);
+            
+            if (result == RangedResult::assetChanged)
+            {
+                // Never splice bytes of two different assets
+                UpdaterConfig::logMessage("Asset changed on server, discarding partial download");
+                discardPartial();
+                
+                info = probe(getSource().url);
+                result = info.acceptsRanges ? runRanged(info) : RangedResult::rangesRejected;
+            }
+            
+            if (result == RangedResult::complete)
+                return true;
+            
+            if (result != RangedResult::rangesRejected)
+                return false;
+            
+            UpdaterConfig::logMessage("Server ignored Range requests, falling back to single stream");
+        }
+        else
+        {
+            UpdaterConfig::logMessage("Ranges not supported, using single stream");
+        }
+        
+        discardPartial();
+        return runSingleStream();
+    }
+    
+    /**
+     * Run download on the calling thread without a destination file:
+     * consumer reads the body while a transfer-pool job keeps the
+     * connection reading ahead of it. Size and SHA-256 are checked once
+     * the whole body has been through, so the consumer's output must not
+     * be used unless this returns true. Nothing is kept for resume.
+     */
+    bool runStreamed(const StreamConsumer& consumer)
+    {
+        UpdaterConfig::logMessage("Streaming: " + url);
+        
+        selectSource();
+        int statusCode = 0;
+        
+        auto stream = juce::URL(getSource().url).createInputStream(
+            juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                .withStatusCode(&statusCode)
+        );
+        
+        if (stream == nullptr || statusCode != 200)
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to open download stream (status " +
+                                    juce::String(statusCode) + ")");
+            return false;
+        }
+        
+        PipelinedStream body(*this, std::move(stream));
+        
+        if (!consumer(body))
+            return false;
+        
+        // Whatever the consumer left (e.g. a zip's central directory) still counts for the hash
+        if (!body.drain())
+            return false;
+        
+        if (!verify(body.getPosition(), isHashing() ? body.getSha256() : juce::String()))
+            return false;
+        
+        UpdaterConfig::logMessage("Stream complete: " + juce::String(body.getPosition()) + " bytes");
+        return true;
+    }
+
+private:
+    using Range = DownloadManifest::Range;
+    
+    enum class RangedResult
+    {
+        complete,
+        failed,             // Partial kept for resume
+        rangesRejected,     // Server answered 200 to a plain Range request
+        assetChanged        // Validator mismatch (If-Range answered with 200/416)
+    };
+    
+    struct Source
+    {
+        juce::String url;           // After redirects
+        int generation = 0;         // Bumped on every switch
+        bool hasValidator = false;  // The manifest's ETag came from this server
+    };
+    
+    //==========================================================================
+    // SEGMENT WORKER
+    //==========================================================================
+    
+    class SegmentJob : public juce::ThreadPoolJob
+    {
+    public:
+        SegmentJob(Downloader& ownerRef, Range& rangeRef, int index)
+            : juce::ThreadPoolJob("Download segment " + juce::String(index)),
+              owner(ownerRef),
+              range(rangeRef)
+        {
+        }
+        
+        JobStatus runJob() override
+        {
+            ResourceGovernor::ScopedBackgroundWork governed;
+            int attempts = 0;
+            
+            while (!shouldExit() && !owner.isRangeComplete(range))
+            {
+                auto source = owner.getSource();
+                
+                if (fetchRange(source))
+                    continue;
+                
+                if (owner.aborted || shouldExit())
+                    break;
+                
+                // Switched away by another segment or the stall check: not our failure
+                if (owner.sourceGeneration != source.generation)
+                    continue;
+                
+                if (++attempts > UpdaterConfig::MAX_SEGMENT_RETRIES)
+                {
+                    owner.aborted = true;
+                    break;
+                }
+                
+                if (owner.switchSource(source.generation))
+                    continue;
+                
+                UpdaterConfig::logMessage(getJobName() + ": connection dropped, retrying");
+                
+                for (int i = 0; i < 5 * attempts && !shouldExit(); ++i)
+                    juce::Thread::sleep(100);
+            }
+            
+            return jobHasFinished;
+        }
+        
+        /**
+         * True if the segment's connection has had no bytes (or is still
+         * connecting) for MIRROR_STALL_MS. A cancelled one isn't stalled.
+         */
+        bool isStalled(juce::uint32 now) const
+        {
+            const juce::ScopedLock lock(streamLock);
+            return live != nullptr && !liveCancelled
+                && now - lastActivity.load() >= (juce::uint32) UpdaterConfig::MIRROR_STALL_MS;
+        }
+        
+        /**
+         * Drop the segment's connection now, rather than when its read
+         * times out; runJob() then reconnects to the current source
+         */
+        void cancelStream()
+        {
+            const juce::ScopedLock lock(streamLock);
+            
+            if (live != nullptr && !liveCancelled)
+            {
+                UpdaterConfig::logMessage(getJobName() + ": stalled, dropping connection");
+                liveCancelled = true;
+                live->cancel();
+            }
+        }
+    
+    private:
+        
+        bool fetchRange(const Source& source)
+        {
+            auto start = owner.getRangePosition(range);
+            
+            juce::String headers = "Range: bytes=" + juce::String(start) +
+                                   "-" + juce::String(range.end - 1) + "\r\n";
+            
+            // Another server's ETag means nothing here; the hash covers mirrors
+            if (source.hasValidator && owner.validator.isNotEmpty())
+                headers << "If-Range: " << owner.validator << "\r\n";
+            
+            juce::WebInputStream stream(juce::URL(source.url), false);
+            stream.withExtraHeaders(headers)
+                  .withConnectionTimeout(UpdaterConfig::HTTP_TIMEOUT_MS);
+            
+            setLive(&stream);
+            
+            // A switch that came before setLive() couldn't cancel this stream
+            bool ok = owner.sourceGeneration == source.generation
+                   && stream.connect(nullptr)
+                   && readRange(stream, source, start);
+            
+            setLive(nullptr);
+            return ok;
+        }
+        
+        bool readRange(juce::WebInputStream& stream, const Source& source, juce::int64 start)
+        {
+            auto statusCode = stream.getStatusCode();
+            
+            if (statusCode != 206)
+            {
+                // A mirror that can't serve this range: fail over, don't give up
+                if (!source.hasValidator)
+                    return false;
+                
+                if (owner.validator.isNotEmpty() && (statusCode == 200 || statusCode == 416))
+                    owner.assetChanged = true;
+                else
+                    owner.rangesRejected = true;
+                
+                owner.aborted = true;
+                return false;
+            }
+            
+            auto position = start;
+            
+            while (position < range.end)
+            {
+                if (shouldExit() || owner.aborted || owner.sourceGeneration != source.generation)
+                    return false;
+                
+                auto wanted = (int) juce::jmin<juce::int64>(bufferSize, range.end - position);
+                auto numRead = stream.read(buffer.getData(), wanted);
+                
+                if (numRead <= 0)
+                    return false;
+                
+                lastActivity = juce::Time::getMillisecondCounter();
+                ResourceGovernor::throttle(numRead);
+                
+                if (!owner.writeRange(range, buffer.getData(), (size_t) numRead))
+                {
+                    owner.aborted = true;
+                    return false;
+                }
+                
+                position += numRead;
+            }
+            
+            return true;
+        }
+        
+        void setLive(juce::WebInputStream* stream)
+        {
+            const juce::ScopedLock lock(streamLock);
+            live = stream;
+            liveCancelled = false;
+            lastActivity = juce::Time::getMillisecondCounter();
+        }
+        
+        static constexpr int bufferSize = 64 * 1024;
+        
+        Downloader& owner;
+        Range& range;
+        juce::HeapBlock<char> buffer { (size_t) bufferSize };
+        
+        // The connection being read, so the stall check can cancel it
+        juce::CriticalSection streamLock;
+        juce::WebInputStream* live = nullptr;
+        bool liveCancelled = false;
+        std::atomic<juce::uint32> lastActivity { 0 };
+        
+        JUCE_DECLARE_NON_COPYABLE(SegmentJob)
+    };
+    
+    //==========================================================================
+    // RANGED MODE
+    //==========================================================================
+    
+    RangedResult runRanged(const ProbeResult& info)
+    {
+        auto totalBytes = info.contentLength;
+        
+        aborted = false;
+        rangesRejected = false;
+        assetChanged = false;
+        
+        auto previous = DownloadManifest::load(manifestFile);
+        
+        if (previous.matches(url, info.etag, info.lastModified, totalBytes)
+            && partFile.getSize() == totalBytes)
+        {
+            manifest = previous;
+            
+            UpdaterConfig::logMessage("Resuming download: " +
+                                    juce::String(manifest.getVerifiedBytes()) + " of " +
+                                    juce::String(totalBytes) + " bytes already on disk");
+        }
+        else
+        {
+            auto numSegments = (int) juce::jlimit<juce::int64>(1, segmentCount,
+                                                             totalBytes / UpdaterConfig::MIN_SEGMENT_BYTES);
+            
+            manifest = DownloadManifest();
+            manifest.url = url;
+            manifest.etag = info.etag;
+            manifest.lastModified = info.lastModified;
+            manifest.split(totalBytes, numSegments);
+            
+            if (!preallocate(totalBytes))
+            {
+                UpdaterConfig::logMessage("ERROR: Failed to preallocate destination");
+                return RangedResult::failed;
+            }
+            
+            UpdaterConfig::logMessage("Ranged download: " + juce::String(numSegments) +
+                                    " segments, " + juce::String(totalBytes) + " bytes");
+        }
+        
+        // Without a validator we can't prove a later resume is safe
+        validator = manifest.getValidator();
+        bool canResume = validator.isNotEmpty();
+        
+        hasher.reset();
+        hashedBytes = 0;
+        
+        // Unbuffered, so bytes are visible to catchUpHash() as soon as
+        // write() returns (no flush needed before reading them back)
+        output = std::make_unique<juce::FileOutputStream>(partFile, 0);
+        
+        if (output->failedToOpen())
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to open partial file");
+            return RangedResult::failed;
+        }
+        
+        bytesDownloaded = manifest.getVerifiedBytes();
+        
+        auto& pool = NetworkEngine::getInstance().getTransferPool();
+        juce::OwnedArray<SegmentJob> jobs;
+        
+        for (int i = 0; i < manifest.ranges.size(); ++i)
+            if (!manifest.ranges.getReference(i).isComplete())
+                pool.addJob(jobs.add(new SegmentJob(*this, manifest.ranges.getReference(i), i)), false);
+        
+        // Report progress and checkpoint the manifest while jobs run
+        auto lastCheckpoint = juce::Time::getMillisecondCounter();
+        
+        for (;;)
+        {
+            bool anyRunning = false;
+            
+            for (auto* job : jobs)
+                anyRunning = anyRunning || pool.contains(job);
+            
+            reportProgress(bytesDownloaded, totalBytes);
+            
+            if (!anyRunning)
+                break;
+            
+            if (NetworkEngine::shouldCurrentJobStop())
+                aborted = true;
+            
+            catchUpHash(totalBytes);
+            
+            auto now = juce::Time::getMillisecondCounter();
+            juce::Array<SegmentJob*> stalled;
+            
+            for (auto* job : jobs)
+                if (job->isStalled(now))
+                    stalled.add(job);
+            
+            // One stuck segment moves them all to the next source (the others
+            // follow after their current read); the stuck ones are cut loose
+            // now instead of at their read timeout. With no other source they
+            // reconnect to the same one.
+            if (!stalled.isEmpty())
+            {
+                switchSource(sourceGeneration);
+                
+                for (auto* job : stalled)
+                    job->cancelStream();
+            }
+            
+            if (canResume && now - lastCheckpoint >= (juce::uint32) UpdaterConfig::RESUME_CHECKPOINT_MS)
+            {
+                checkpoint();
+                lastCheckpoint = now;
+            }
+            
+            juce::Thread::sleep(100);
+        }
+        
+        for (auto* job : jobs)
+            pool.removeJob(job, true, 5000);
+        
+        jobs.clear();
+        
+        if (canResume && !assetChanged)
+            checkpoint();
+        
+        output = nullptr;
+        
+        if (assetChanged)
+            return RangedResult::assetChanged;
+        
+        if (rangesRejected)
+            return RangedResult::rangesRejected;
+        
+        if (!manifest.isComplete())
+        {
+            UpdaterConfig::logMessage("ERROR: Download incomplete, " +
+                                    juce::String(manifest.getVerifiedBytes()) + " of " +
+                                    juce::String(totalBytes) + " bytes kept for resume");
+            return RangedResult::failed;
+        }
+        
+        catchUpHash(totalBytes);
+        
+        if (!verify(totalBytes, hashedBytes == totalBytes ? hasher.finish() : juce::String()))
+        {
+            // Bad bytes are never worth resuming from
+            discardPartial();
+            return RangedResult::failed;
+        }
+        
+        destination.deleteFile();
+        
+        if (!partFile.moveFileTo(destination))
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to move completed download into place");
+            return RangedResult::failed;
+        }
+        
+        manifestFile.deleteFile();
+        
+        UpdaterConfig::logMessage("Download complete: " + juce::String(totalBytes) + " bytes");
+        return RangedResult::complete;
+    }
+    
+    /**
+     * Create partial file at its final size so segments can write anywhere
+     */
+    bool preallocate(juce::int64 totalBytes)
+    {
+        discardPartial();
+        
+        juce::FileOutputStream stream(partFile);
+        
+        if (stream.failedToOpen())
+            return false;
+        
+        stream.setPosition(totalBytes - 1);
+        stream.writeByte(0);
+        stream.flush();
+        
+        return stream.getStatus().wasOk();
+    }
+    
+    /**
+     * Flush written bytes to disk, then record how far each range got.
+     * Flushing first guarantees the manifest never claims unwritten bytes.
+     */
+    void checkpoint()
+    {
+        const juce::ScopedLock lock(writeLock);
+        
+        output->flush();
+        
+        if (!output->getStatus().wasOk() || !manifest.save(manifestFile))
+            UpdaterConfig::logMessage("WARNING: Failed to checkpoint download manifest");
+    }
+    
+    bool writeRange(Range& range, const void* data, size_t numBytes)
+    {
+        const juce::ScopedLock lock(writeLock);
+        
+        if (!output->setPosition(range.position) || !output->write(data, numBytes))
+            return false;
+        
+        // The segment at the hash cursor is hashed straight from its buffer
+        if (isHashing() && range.position == hashedBytes)
+        {
+            hasher.update(data, numBytes);
+            hashedBytes += (juce::int64) numBytes;
+        }
+        
+        range.position += (juce::int64) numBytes;
+        bytesDownloaded += (juce::int64) numBytes;
+        return true;
+    }
+    
+    juce::int64 getRangePosition(const Range& range)
+    {
+        const juce::ScopedLock lock(writeLock);
+        return range.position;
+    }
+    
+    bool isRangeComplete(const Range& range)
+    {
+        const juce::ScopedLock lock(writeLock);
+        return range.isComplete();
+    }
+    
+    //==========================================================================
+    // SOURCES
+    //==========================================================================
+    
+    /**
+     * Rank the asset URL and its mirrors; start with the fastest.
+     * Mirrors are only used when a SHA-256 can prove their bytes: with
+     * a size check alone, the asset URL is the only source.
+     */
+    void selectSource()
+    {
+        juce::StringArray candidates(url);
+        
+        if (isHashing())
+            candidates.addArray(mirrors);
+        else if (!mirrors.isEmpty())
+            UpdaterConfig::logMessage("No SHA-256 to verify mirrors against, using " + MirrorSelector::getHost(url) + " only");
+        
+        juce::StringArray ranked;
+        
+        for (auto& source : MirrorSelector::rank(candidates, expectedSize))
+            ranked.add(source.url);
+        
+        // A network round trip: not under sourceLock
+        auto resolved = NetworkEngine::getInstance().resolveRedirects(ranked[0]);
+        
+        const juce::ScopedLock lock(sourceLock);
+        sources = ranked;
+        sourceIndex = 0;
+        validatorSource = 0;
+        fetchUrl = resolved;
+        
+        if (sources[0] != url)
+            UpdaterConfig::logMessage("From mirror: " + MirrorSelector::getHost(sources[0]));
+    }
+    
+    Source getSource()
+    {
+        const juce::ScopedLock lock(sourceLock);
+        return { fetchUrl, sourceGeneration.load(), sourceIndex == validatorSource };
+    }
+    
+    /**
+     * Move every segment to the next source, keeping their positions.
+     * Returns false if there is nowhere to go. Several segments noticing
+     * the same failure switch only once (fromGeneration).
+     */
+    bool switchSource(int fromGeneration)
+    {
+        juce::String next;
+        
+        {
+            const juce::ScopedLock lock(sourceLock);
+            
+            if (sources.size() < 2 || !isHashing())
+                return false;
+            
+            if (sourceGeneration != fromGeneration)
+                return true;
+            
+            next = sources[(sourceIndex + 1) % sources.size()];
+        }
+        
+        // A network round trip: getSource() callers aren't held up by it
+        auto resolved = NetworkEngine::getInstance().resolveRedirects(next);
+        
+        const juce::ScopedLock lock(sourceLock);
+        
+        // Someone else switched while this was resolving
+        if (sourceGeneration != fromGeneration)
+            return true;
+        
+        sourceIndex = (sourceIndex + 1) % sources.size();
+        fetchUrl = resolved;
+        ++sourceGeneration;
+        
+        UpdaterConfig::logMessage("Switching download source to " +
+                                MirrorSelector::getHost(sources[sourceIndex]) + " at " +
+                                juce::String(bytesDownloaded.load()) + " bytes");
+        return true;
+    }
+    
+    //==========================================================================
+    // VERIFICATION
+    //==========================================================================
+    
+    bool isHashing() const { return expectedSha256.isNotEmpty(); }
+    
+    /**
+     * Move the hash cursor over bytes that segments wrote ahead of it.
+     * 
+     * Only the segment the cursor is in can be hashed from its buffer;
+     * later segments' bytes are read back from the partial file once the
+     * cursor reaches them. They were written moments ago (or are the
+     * already-downloaded part of a resume), so this is served from the
+     * page cache rather than being a second pass over the disk.
+     */
+    void catchUpHash(juce::int64 totalBytes)
+    {
+        if (!isHashing())
+            return;
+        
+        std::unique_ptr<juce::FileInputStream> reader;
+        juce::HeapBlock<char> chunk;
+        constexpr int chunkSize = 256 * 1024;
+        
+        for (;;)
+        {
+            juce::int64 from = 0, to = 0;
+            
+            {
+                const juce::ScopedLock lock(writeLock);
+                from = hashedBytes;
+                to = from;
+                
+                for (auto& r : manifest.ranges)
+                    if (r.start <= from && from < r.end)
+                        to = r.position;
+            }
+            
+            if (to <= from || from >= totalBytes)
+                return;
+            
+            if (reader == nullptr)
+            {
+                reader = std::make_unique<juce::FileInputStream>(partFile);
+                chunk.malloc(chunkSize);
+                
+                if (reader->failedToOpen())
+                    return;
+            }
+            
+            auto numBytes = (int) juce::jmin<juce::int64>(chunkSize, to - from);
+            
+            if (!reader->setPosition(from) || reader->read(chunk.getData(), numBytes) != numBytes)
+                return;
+            
+            const juce::ScopedLock lock(writeLock);
+            
+            if (hashedBytes == from)
+            {
+                hasher.update(chunk.getData(), (size_t) numBytes);
+                hashedBytes += numBytes;
+            }
+        }
+    }
+    
+    /**
+     * Check the finished download against published size and digest
+     */
+    bool verify(juce::int64 numBytes, const juce::String& actualSha256)
+    {
+        if (expectedSize >= 0 && numBytes != expectedSize)
+        {
+            UpdaterConfig::logMessage("ERROR: Download size mismatch: got " + juce::String(numBytes) +
+                                    " bytes, expected " + juce::String(expectedSize));
+            return false;
+        }
+        
+        if (!isHashing())
+            return true;
+        
+        if (actualSha256 != expectedSha256)
+        {
+            UpdaterConfig::logMessage("ERROR: SHA-256 mismatch: got " + actualSha256 +
+                                    ", expected " + expectedSha256);
+            return false;
+        }
+        
+        UpdaterConfig::logMessage("SHA-256 verified: " + actualSha256);
+        return true;
+    }
+    
+    void discardPartial()
+    {
+        partFile.deleteFile();
+        manifestFile.deleteFile();
+    }
+    
+    //==========================================================================
+    // SINGLE STREAM MODE
+    //==========================================================================
+    
+    bool runSingleStream()
+    {
+        // Create output stream
+        destination.deleteFile();
+        auto outputStream = destination.createOutputStream();
+        
+        if (!outputStream)
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to create output stream");
+            return false;
+        }
+        
+        // Progress is reported from the read loop below; JUCE's own
+        // progress callback uses int and overflows above 2 GB
+        auto inputStream = juce::URL(getSource().url).createInputStream(
+            juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+        );
+        
+        if (!inputStream)
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to create input stream");
+            return false;
+        }
+        
+        // Download
+        juce::HeapBlock<char> buffer(64 * 1024);
+        juce::int64 bytesWritten = 0;
+        auto totalBytes = inputStream->getTotalLength();
+        Sha256 streamHasher;
+        
+        while (!NetworkEngine::shouldCurrentJobStop())
+        {
+            auto numRead = inputStream->read(buffer.getData(), 64 * 1024);
+            
+            if (numRead <= 0)
+                break;
+            
+            ResourceGovernor::throttle(numRead);
+            
+            if (!outputStream->write(buffer.getData(), (size_t) numRead))
+            {
+                UpdaterConfig::logMessage("ERROR: Failed to write download");
+                return false;
+            }
+            
+            if (isHashing())
+                streamHasher.update(buffer.getData(), (size_t) numRead);
+            
+            bytesWritten += numRead;
+            reportProgress(bytesWritten, totalBytes);
+        }
+        
+        outputStream = nullptr;
+        
+        if (NetworkEngine::shouldCurrentJobStop())
+        {
+            UpdaterConfig::logMessage("Download cancelled");
+            destination.deleteFile();
+            return false;
+        }
+        
+        if (bytesWritten <= 0)
+        {
+            UpdaterConfig::logMessage("ERROR: Download failed, 0 bytes written");
+            destination.deleteFile();
+            return false;
+        }
+        
+        // A dropped connection looks like a normal end of stream
+        if (totalBytes >= 0 && bytesWritten != totalBytes)
+        {
+            UpdaterConfig::logMessage("ERROR: Download truncated at " + juce::String(bytesWritten) +
+                                    " of " + juce::String(totalBytes) + " bytes");
+            destination.deleteFile();
+            return false;
+        }
+        
+        if (!verify(bytesWritten, isHashing() ? streamHasher.finish() : juce::String()))
+        {
+            destination.deleteFile();
+            return false;
+        }
+        
+        UpdaterConfig::logMessage("Download complete: " +
+                                juce::String(bytesWritten) + " bytes");
+        return true;
+    }
+    
+    //==========================================================================
+    // STREAMED MODE
+    //==========================================================================
+    
+    /**
+     * The response body as an InputStream. A job on the transfer pool
+     * reads up to STREAM_READ_AHEAD_BYTES ahead (throttled, hashed and
+     * counted as it goes), so the network stays busy while the reader
+     * is decompressing or writing.
+     */
+    class PipelinedStream : public juce::InputStream
+    {
+    public:
+        PipelinedStream(Downloader& ownerRef, std::unique_ptr<juce::InputStream> sourceStream)
+            : owner(ownerRef),
+              source(std::move(sourceStream)),
+              totalLength(source->getTotalLength()),
+              job(*this)
+        {
+            NetworkEngine::getInstance().getTransferPool().addJob(&job, false);
+        }
+        
+        ~PipelinedStream() override
+        {
+            stopped = true;
+            spaceAvailable.signal();
+            NetworkEngine::getInstance().getTransferPool().removeJob(&job, true, -1);
+        }
+        
+        int read(void* destBuffer, int maxBytesToRead) override
+        {
+            auto* dest = static_cast<char*>(destBuffer);
+            int numRead = 0;
+            
+            while (numRead < maxBytesToRead)
+            {
+                {
+                    const juce::ScopedLock lock(queueLock);
+                    
+                    if (!pending.empty())
+                    {
+                        auto& chunk = pending.front();
+                        auto n = juce::jmin(maxBytesToRead - numRead, (int) (chunk.getSize() - frontOffset));
+                        
+                        std::memcpy(dest + numRead, static_cast<const char*>(chunk.getData()) + frontOffset, (size_t) n);
+                        numRead += n;
+                        frontOffset += (size_t) n;
+                        
+                        if (frontOffset == chunk.getSize())
+                        {
+                            queuedBytes -= (juce::int64) chunk.getSize();
+                            pending.pop_front();
+                            frontOffset = 0;
+                            spaceAvailable.signal();
+                        }
+                        
+                        continue;
+                    }
+                    
+                    if (finished)
+                        break;
+                }
+                
+                // Hand over what has arrived rather than waiting for a full buffer
+                if (numRead > 0)
+                    break;
+                
+                if (NetworkEngine::shouldCurrentJobStop())
+                {
+                    stopped = true;
+                    spaceAvailable.signal();
+                    break;
+                }
+                
+                dataAvailable.wait(100);
+            }
+            
+            position += numRead;
+            return numRead;
+        }
+        
+        juce::int64 getTotalLength() override   { return totalLength; }
+        juce::int64 getPosition() override      { return position; }
+        bool setPosition(juce::int64) override  { return false; }
+        
+        bool isExhausted() override
+        {
+            const juce::ScopedLock lock(queueLock);
+            return finished && pending.empty();
+        }
+        
+        /**
+         * Read to the end of the body. Returns false if the transfer
+         * was cut short or cancelled.
+         */
+        bool drain()
+        {
+            juce::HeapBlock<char> buffer(chunkSize);
+            
+            while (read(buffer.getData(), chunkSize) > 0)
+            {
+            }
+            
+            const juce::ScopedLock lock(queueLock);
+            
+            if (!complete)
+                return false;
+            
+            // A dropped connection looks like a normal end of stream
+            if (totalLength >= 0 && received != totalLength)
+            {
+                UpdaterConfig::logMessage("ERROR: Download truncated at " + juce::String(received) +
+                                        " of " + juce::String(totalLength) + " bytes");
+                return false;
+            }
+            
+            return received > 0;
+        }
+        
+        /**
+         * Digest of everything received; only valid after drain()
+         */
+        juce::String getSha256() { return hasher.finish(); }
+    
+    private:
+        static constexpr int chunkSize = 64 * 1024;
+        
+        class ReaderJob : public juce::ThreadPoolJob
+        {
+        public:
+            explicit ReaderJob(PipelinedStream& streamRef)
+                : juce::ThreadPoolJob("Download stream"), stream(streamRef) {}
+            
+            JobStatus runJob() override
+            {
+                ResourceGovernor::ScopedBackgroundWork governed;
+                stream.pump(*this);
+                return jobHasFinished;
+            }
+        
+        private:
+            PipelinedStream& stream;
+        };
+        
+        /**
+         * Reader job body: network -> queue until the end of the body,
+         * a cancel, or the consumer going away
+         */
+        void pump(const juce::ThreadPoolJob& readerJob)
+        {
+            while (!readerJob.shouldExit() && !stopped)
+            {
+                juce::MemoryBlock chunk((size_t) chunkSize);
+                auto numRead = source->read(chunk.getData(), chunkSize);
+                
+                if (numRead <= 0)
+                    break;
+                
+                ResourceGovernor::throttle(numRead);
+                chunk.setSize((size_t) numRead);
+                
+                if (owner.isHashing())
+                    hasher.update(chunk.getData(), (size_t) numRead);
+                
+                // Wait for the consumer when it falls too far behind
+                while (!readerJob.shouldExit() && !stopped)
+                {
+                    {
+                        const juce::ScopedLock lock(queueLock);
+                        
+                        if (queuedBytes < UpdaterConfig::STREAM_READ_AHEAD_BYTES)
+                        {
+                            received += numRead;
+                            queuedBytes += numRead;
+                            pending.push_back(std::move(chunk));
+                            break;
+                        }
+                    }
+                    
+                    spaceAvailable.wait(100);
+                }
+                
+                dataAvailable.signal();
+                owner.bytesDownloaded = received;
+                owner.reportProgress(received, totalLength);
+            }
+            
+            {
+                const juce::ScopedLock lock(queueLock);
+                finished = true;
+                complete = !readerJob.shouldExit() && !stopped;
+            }
+            
+            dataAvailable.signal();
+        }
+        
+        //======================================================================
+        
+        Downloader& owner;
+        std::unique_ptr<juce::InputStream> source;
+        const juce::int64 totalLength;
+        juce::int64 position = 0;       // Consumer side
+        
+        juce::CriticalSection queueLock;
+        std::deque<juce::MemoryBlock> pending;
+        size_t frontOffset = 0;
+        juce::int64 queuedBytes = 0;
+        juce::int64 received = 0;
+        bool finished = false;          // No more data will be queued
+        bool complete = false;          // ...because the body ended (not cancelled)
+        std::atomic<bool> stopped { false };
+        juce::WaitableEvent dataAvailable, spaceAvailable;
+        
+        Sha256 hasher;                  // Written by the job until finished
+        ReaderJob job;
+        
+        JUCE_DECLARE_NON_COPYABLE(PipelinedStream)
+    };
+    
+    //==========================================================================
+    
+    void reportProgress(juce::int64 done, juce::int64 total)
+    {
+        if (progressCallback)
+            progressCallback(done, total);
+    }
+    
+    //==========================================================================
+    
+    juce::String url;           // Asset URL (identity for resume)
+    juce::StringArray mirrors;
+    juce::File destination;
+    juce::File partFile;
+    juce::File manifestFile;
+    int segmentCount;
+    ProgressCallback progressCallback;
+    
+    DownloadManifest manifest;
+    juce::String validator;
+    
+    juce::StringArray sources;      // Ranked, fastest first
+    juce::String fetchUrl;          // Current source after redirects
+    int sourceIndex = 0;
+    int validatorSource = 0;        // Source the manifest's validators came from
+    std::atomic<int> sourceGeneration { 0 };
+    juce::CriticalSection sourceLock;
+    
+    juce::String expectedSha256;
+    juce::int64 expectedSize = -1;
+    Sha256 hasher;                  // Guarded by writeLock
+    juce::int64 hashedBytes = 0;    // Hash cursor: [0, hashedBytes) is hashed
+    
+    std::unique_ptr<juce::FileOutputStream> output;
+    juce::CriticalSection writeLock;
+    
+    std::atomic<juce::int64> bytesDownloaded { 0 };
+    std::atomic<bool> rangesRejected { false };
+    std::atomic<bool> assetChanged { false };
+    std::atomic<bool> aborted { false };
+    
+    JUCE_DECLARE_NON_COPYABLE(Downloader)
+};
\ No newline at end of file
@@ -0,0 +1,188 @@
+/*
+  FileClone.h - Duplicate a file or bundle as cheaply as the filesystem allows
+  
+  Tried in order:
+  - Reflink (copy-on-write clone): FICLONE on Btrfs/XFS, clonefile on
+    APFS. Instant, and no extra space until one side is changed.
+  - Hard link, if the caller says neither side is ever written in
+    place (the updater only replaces files by renaming new ones over
+    them, so this holds for installed plugins and backups).
+  - A full byte copy, done inside the kernel (CopyEngine).
+  
+  Bundles are cloned file by file on CopyEngine's pool (APFS clones the
+  whole tree in one call).
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "CopyEngine.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/stat.h>
+ #if JUCE_LINUX
+  #include <sys/ioctl.h>
+  #include <linux/fs.h>
+  #ifndef FICLONE
+   #define FICLONE _IOW(0x94, 9, int)
+  #endif
+ #elif JUCE_MAC
+  #include <sys/attr.h>
+  #include <sys/clonefile.h>
+ #endif
+#endif
+
+class FileClone
+{
+public:
+    enum class Method
+    {
+        reflink,
+        hardLink,
+        copy
+    };
+    
+    /**
+     * Duplicate source (file or directory) at target, which must not
+     * exist. allowHardLinks: only if neither copy is ever modified in
+     * place. method receives the most expensive method that was needed.
+     */
+    static bool cloneItem(const juce::File& source, const juce::File& target,
+                          bool allowHardLinks, Method* method = nullptr)
+    {
+        auto used = Method::reflink;
+        bool ok = false;
+        
+        if (source.isDirectory())
+        {
+            #if JUCE_MAC
+                ok = clonefile(source.getFullPathName().toRawUTF8(),
+                               target.getFullPathName().toRawUTF8(), CLONE_NOFOLLOW) == 0;
+            #endif
+
+            if (!ok)
+                ok = cloneDirectory(source, target, allowHardLinks, used);
+        }
+        else
+        {
+            ok = cloneFile(source, target, allowHardLinks, used);
+            
+            // Copied bytes aren't on disk yet; links and reflinks bring none of their own
+            if (ok && used == Method::copy)
+                ok = CopyEngine::syncToDisk(target);
+        }
+        
+        if (method != nullptr)
+            *method = used;
+        
+        return ok;
+    }
+    
+    static juce::String getName(Method method)
+    {
+        switch (method)
+        {
+            case Method::reflink:   return "reflink";
+            case Method::hardLink:  return "hard link";
+            case Method::copy:
+            default:                return "copy";
+        }
+    }
+
+private:
+    static bool cloneDirectory(const juce::File& source, const juce::File& target,
+                               bool allowHardLinks, Method& used)
+    {
+        juce::SpinLock lock;
+        
+        // Files are cloned in parallel; keep the most expensive method any of them needed
+        return CopyEngine::copyItem(source, target, [&](const juce::File& from, const juce::File& to)
+        {
+            auto method = Method::reflink;
+            
+            if (!cloneFile(from, to, allowHardLinks, method))
+                return false;
+            
+            const juce::SpinLock::ScopedLockType sl(lock);
+            used = juce::jmax(used, method);
+            return true;
+        });
+    }
+    
+    static bool cloneFile(const juce::File& source, const juce::File& target,
+                          bool allowHardLinks, Method& used)
+    {
+        if (reflink(source, target))
+            return true;
+        
+        if (allowHardLinks && hardLink(source, target))
+        {
+            used = juce::jmax(used, Method::hardLink);
+            return true;
+        }
+        
+        used = Method::copy;
+        return CopyEngine::copyFile(source, target);
+    }
+    
+    //==========================================================================
+    // PLATFORM
+    //==========================================================================
+    
+    static bool reflink(const juce::File& source, const juce::File& target)
+    {
+        #if JUCE_LINUX
+            auto in = open(source.getFullPathName().toRawUTF8(), O_RDONLY | O_CLOEXEC);
+            
+            if (in < 0)
+                return false;
+            
+            struct stat info {};
+            fstat(in, &info);
+            
+            auto out = open(target.getFullPathName().toRawUTF8(),
+                            O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, info.st_mode & 07777);
+            
+            bool ok = out >= 0 && ioctl(out, FICLONE, in) == 0;
+            
+            if (out >= 0)
+                close(out);
+            
+            close(in);
+            
+            // Not supported here (ext4, tmpfs, another volume): leave no empty file behind
+            if (!ok && out >= 0)
+                unlink(target.getFullPathName().toRawUTF8());
+            
+            return ok;
+
+        #elif JUCE_MAC
+            return clonefile(source.getFullPathName().toRawUTF8(),
+                             target.getFullPathName().toRawUTF8(), CLONE_NOFOLLOW) == 0;
+
+        #else
+            juce::ignoreUnused(source, target);
+            return false;
+        #endif
+    }
+    
+    static bool hardLink(const juce::File& source, const juce::File& target)
+    {
+        #if JUCE_WINDOWS
+            return CreateHardLinkW(target.getFullPathName().toWideCharPointer(),
+                                   source.getFullPathName().toWideCharPointer(), nullptr) != 0;
+        #else
+            return link(source.getFullPathName().toRawUTF8(), target.getFullPathName().toRawUTF8()) == 0;
+        #endif
+    }
+};
\ No newline at end of file
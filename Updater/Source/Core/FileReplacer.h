@@ -1,12 +1,39 @@
 /*
   FileReplacer.h - Safe file replacement with backup
   
-  Handles replacing the plugin file safely with automatic backup
+  Handles replacing the plugin file safely with automatic backup.
+  The plugin is a single file or a bundle directory; both are handled.
+  
+  The new version is staged next to the installed one and swapped in
+  with a rename (see FileSwap), and the old version is renamed to the
+  backup rather than copied. Install time doesn't depend on plugin size
+  and the plugin is never missing. Where a copy can't be avoided
+  (restoring while keeping the backup, staging from another volume)
+  it is a reflink or hard link when the filesystem allows (FileClone).
+  Versions kept in the InstallStore are switched to the same way.
+  
+  An update goes to every install target at once (getInstallTargets in
+  Config.h): each target's artifact is staged next to it in parallel,
+  as a clone of the one unpacked copy, and the swaps follow back to
+  back. On one volume an extra target costs a link and a rename, not
+  another download or copy.
+  
+  Every install is journaled (InstallJournal) as one transaction over
+  all its targets, so one cut short by a crash or power loss is
+  completed or undone everywhere on the next start.
 */
 
 #pragma once
 #include <juce_core/juce_core.h>
+#include <atomic>
+#include <vector>
 #include "../Config.h"
+#include "ArchiveExtractor.h"
+#include "CopyEngine.h"
+#include "FileClone.h"
+#include "FileSwap.h"
+#include "InstallJournal.h"
+#include "InstallStore.h"
 #include "ProcessMonitor.h"
 
 class FileReplacer
@@ -22,6 +49,15 @@ public:
         FileNotFound
     };
     
+    /**
+     * One artifact going to one install target
+     */
+    struct Install
+    {
+        juce::File source;      // Unpacked artifact; several installs may share it
+        juce::File target;
+    };
+    
     /**
      * Replace plugin file with new version
      * 
@@ -31,90 +67,162 @@ public:
      */
     static Result replacePlugin(const juce::File& newFile, bool createBackup = true)
     {
-        auto targetFile = UpdaterConfig::getPluginInstallPath();
+        juce::Array<Install> installs;
+        installs.add({ newFile, UpdaterConfig::getPluginInstallPath() });
+        return replaceTargets(installs, createBackup);
+    }
+    
+    /**
+     * What an update installs: plugin to the plugin's path, plus each
+     * other install target whose artifact was unpacked into stagingDir
+     * along with it. Targets marked onlyIfInstalled are left alone
+     * unless present, and targets that can't be written (a system-wide
+     * scope without admin rights) are skipped rather than failing the
+     * whole update.
+     */
+    static juce::Array<Install> getInstalls(const juce::File& plugin, const juce::File& stagingDir)
+    {
+        auto targets = UpdaterConfig::getInstallTargets();
+        juce::Array<Install> installs;
+        installs.add({ plugin, targets.getReference(0).path });
         
+        for (int i = 1; i < targets.size(); ++i)
+        {
+            auto& target = targets.getReference(i);
+            auto source = target.artifact.endsWithIgnoreCase(".vst3") ? plugin
+                        : plugin.isAChildOf(stagingDir) ? ArchiveExtractor::findArtifact(stagingDir, target.artifact)
+                                                        : juce::File();
+            
+            if (!source.exists() || (target.onlyIfInstalled && !target.path.exists()))
+                continue;
+            
+            // Swapping needs the folder writable (JUCE checks the nearest existing one)
+            if (!target.path.getParentDirectory().hasWriteAccess())
+            {
+                UpdaterConfig::logMessage("Skipping " + target.path.getFullPathName() + " (not writable)");
+                continue;
+            }
+            
+            installs.add({ source, target.path });
+        }
+        
+        return installs;
+    }
+    
+    /**
+     * Install each source to its target in one transaction: all of them
+     * are staged in parallel next to their targets, then swapped in
+     * together. Either every target ends up updated or none is.
+     * The first install is the plugin: with createBackup the version it
+     * replaces becomes the backup. The versions the others replace are
+     * dropped. Sources are moved where possible, so they are used up.
+     */
+    static Result replaceTargets(const juce::Array<Install>& installs, bool createBackup = true)
+    {
         UpdaterConfig::logMessage("===========================================");
         UpdaterConfig::logMessage("REPLACING PLUGIN FILE");
-        UpdaterConfig::logMessage("From: " + newFile.getFullPathName());
-        UpdaterConfig::logMessage("To: " + targetFile.getFullPathName());
+        
+        for (auto& install : installs)
+            UpdaterConfig::logMessage(install.source.getFullPathName() + " -> " + install.target.getFullPathName());
+        
         UpdaterConfig::logMessage("===========================================");
         
-        // 1. Check if new file exists
-        if (!newFile.existsAsFile())
-        {
-            UpdaterConfig::logMessage("ERROR: New file does not exist");
-            return Result::FileNotFound;
-        }
+        juce::Array<InstallJournal::Item> items;
         
-        // 2. Check if target file is locked
-        if (targetFile.existsAsFile() && ProcessMonitor::isFileLocked(targetFile))
+        for (int i = 0; i < installs.size(); ++i)
         {
-            UpdaterConfig::logMessage("ERROR: Target file is locked");
+            auto& install = installs.getReference(i);
+            
+            // 1. Check if new file (or bundle) exists
+            if (!install.source.exists())
+            {
+                UpdaterConfig::logMessage("ERROR: New file does not exist: " + install.source.getFullPathName());
+                return Result::FileNotFound;
+            }
             
-            // Wait for unlock (5 seconds)
-            if (!ProcessMonitor::waitForFileUnlock(targetFile, 5000))
+            // 2. Check if target file is locked (wait up to 5 seconds for it)
+            if (install.target.existsAsFile() && ProcessMonitor::isFileLocked(install.target)
+                && !ProcessMonitor::waitForFileUnlock(install.target, 5000))
             {
+                UpdaterConfig::logMessage("ERROR: Target file is locked: " + install.target.getFullPathName());
                 return Result::FileLocked;
             }
-        }
-        
-        // 3. Create backup if requested
-        if (createBackup && targetFile.existsAsFile())
-        {
-            UpdaterConfig::logMessage("Creating backup...");
             
-            auto backupFile = UpdaterConfig::getBackupFile();
+            // 3. Make room for the old version (renamed, not copied)
+            InstallJournal::Item item;
+            item.target = install.target;
+            item.staged = getSibling(install.target, ".new");
+            item.keepDisplaced = i == 0 && createBackup;
+            item.displaced = item.keepDisplaced ? UpdaterConfig::getBackupFile() : getSibling(install.target, ".old");
             
-            if (!targetFile.copyFileTo(backupFile))
+            if (!deleteItem(item.displaced) || !deleteItem(item.staged))
             {
-                UpdaterConfig::logMessage("ERROR: Failed to create backup");
+                UpdaterConfig::logMessage("ERROR: Failed to remove old backup");
                 return Result::BackupFailed;
             }
             
-            UpdaterConfig::logMessage("Backup created: " + backupFile.getFullPathName());
+            install.target.getParentDirectory().createDirectory();
+            items.add(item);
         }
         
-        // 4. Ensure target directory exists
-        targetFile.getParentDirectory().createDirectory();
+        // 4. Stage every new version on its target's volume
+        auto journal = InstallJournal::begin(items);
+        
+        UpdaterConfig::logMessage("Staging new files...");
+        
+        if (!stageAll(installs, journal))
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to stage new files");
+            discardStaged(installs, journal);
+            InstallJournal::finish(journal);
+            return Result::CopyFailed;
+        }
         
-        // 5. Replace file
-        UpdaterConfig::logMessage("Copying new file...");
+        InstallJournal::markStaged(journal);
         
-        // Delete old file first
-        if (targetFile.existsAsFile())
+        // 5. Swap them in, all or none
+        for (int i = 0; i < installs.size(); ++i)
         {
-            if (!targetFile.deleteFile())
+            auto& item = journal.items.getReference(i);
+            
+            if (FileSwap::install(item.staged, item.target, item.displaced))
+                continue;
+            
+            UpdaterConfig::logMessage("ERROR: Failed to swap in " + item.target.getFullPathName());
+            
+            if (!unswap(journal, i))
             {
-                UpdaterConfig::logMessage("ERROR: Failed to delete old file");
-                
-                // Try to restore backup
-                if (createBackup)
-                    restoreBackup();
-                
+                // The journal still says "staged": the next start completes the install
+                UpdaterConfig::logMessage("ERROR: Could not undo the partial install");
                 return Result::PermissionDenied;
             }
+            
+            discardStaged(installs, journal);
+            InstallJournal::finish(journal);
+            return Result::PermissionDenied;
         }
         
-        // Copy new file
-        if (!newFile.copyFileTo(targetFile))
+        InstallJournal::markSwapped(journal);
+        
+        for (auto& item : journal.items)
         {
-            UpdaterConfig::logMessage("ERROR: Failed to copy new file");
-            
-            // Try to restore backup
-            if (createBackup)
-                restoreBackup();
-            
-            return Result::CopyFailed;
+            if (item.keepDisplaced && item.displaced.exists())
+                UpdaterConfig::logMessage("Backup kept: " + item.displaced.getFullPathName());
+            else
+                deleteItem(item.displaced);
         }
         
-        UpdaterConfig::logMessage("✅ Plugin replaced successfully!");
+        InstallJournal::finish(journal);
+        
+        UpdaterConfig::logMessage("✅ Plugin replaced successfully! (" + juce::String(installs.size()) + " target(s))");
         UpdaterConfig::logMessage("===========================================");
         
         return Result::Success;
     }
     
     /**
-     * Restore plugin from backup
+     * Restore plugin from backup. The backup is cloned, not moved, so
+     * it is still there to restore from again.
      */
     static bool restoreBackup()
     {
@@ -123,27 +231,100 @@ public:
         auto backupFile = UpdaterConfig::getBackupFile();
         auto targetFile = UpdaterConfig::getPluginInstallPath();
         
-        if (!backupFile.existsAsFile())
+        if (!backupFile.exists())
         {
             UpdaterConfig::logMessage("ERROR: Backup file does not exist");
             return false;
         }
         
-        // Delete current file
-        if (targetFile.existsAsFile())
-            targetFile.deleteFile();
+        // Clone it next to the target and swap that in; the version it replaces is dropped
+        auto staged = getSibling(targetFile, ".new");
+        auto displaced = getSibling(targetFile, ".old");
+        auto method = FileClone::Method::copy;
+        
+        deleteItem(displaced);
+        deleteItem(staged);
+        
+        auto journal = InstallJournal::begin(targetFile, staged, displaced, false);
+        bool ok = FileClone::cloneItem(backupFile, staged, true, &method);
         
-        // Restore backup
-        if (backupFile.copyFileTo(targetFile))
+        if (ok)
         {
-            UpdaterConfig::logMessage("✅ Backup restored successfully");
-            return true;
+            InstallJournal::markStaged(journal);
+            ok = FileSwap::install(staged, targetFile, displaced);
+        }
+        
+        if (ok)
+        {
+            InstallJournal::markSwapped(journal);
+            deleteItem(displaced);
+            UpdaterConfig::logMessage("✅ Backup restored successfully (" + FileClone::getName(method) + ")");
         }
         else
         {
+            deleteItem(staged);
             UpdaterConfig::logMessage("ERROR: Failed to restore backup");
-            return false;
         }
+        
+        InstallJournal::finish(journal);
+        return ok;
+    }
+    
+    /**
+     * Switch to a version kept in the InstallStore (rollback, or back
+     * forward). It is rebuilt from the store next to the target and
+     * swapped in; the version it replaces is dropped.
+     */
+    static Result activateGeneration(const juce::String& id)
+    {
+        auto targetFile = UpdaterConfig::getPluginInstallPath();
+        
+        UpdaterConfig::logMessage("Switching to install generation " + id);
+        
+        if (targetFile.existsAsFile() && ProcessMonitor::isFileLocked(targetFile)
+            && !ProcessMonitor::waitForFileUnlock(targetFile, 5000))
+        {
+            UpdaterConfig::logMessage("ERROR: Target file is locked");
+            return Result::FileLocked;
+        }
+        
+        // Whatever is installed now stays reachable unless it's already in the store
+        InstallStore::recordIfUnknown(targetFile);
+        
+        auto staged = getSibling(targetFile, ".new");
+        auto displaced = getSibling(targetFile, ".old");
+        
+        targetFile.getParentDirectory().createDirectory();
+        
+        if (!deleteItem(staged) || !deleteItem(displaced))
+            return Result::PermissionDenied;
+        
+        auto journal = InstallJournal::begin(targetFile, staged, displaced, false);
+        
+        if (!InstallStore::materialise(id, staged))
+        {
+            InstallJournal::finish(journal);
+            return Result::CopyFailed;
+        }
+        
+        InstallJournal::markStaged(journal);
+        
+        if (!FileSwap::install(staged, targetFile, displaced))
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to swap in install generation");
+            deleteItem(staged);
+            InstallJournal::finish(journal);
+            return Result::PermissionDenied;
+        }
+        
+        InstallJournal::markSwapped(journal);
+        deleteItem(displaced);
+        InstallJournal::finish(journal);
+        InstallStore::setActiveId(id);
+        InstallStore::prune(UpdaterConfig::INSTALL_GENERATIONS_KEPT);
+        
+        UpdaterConfig::logMessage("✅ Switched to install generation " + id);
+        return Result::Success;
     }
     
     /**
@@ -153,9 +334,9 @@ public:
     {
         auto backupFile = UpdaterConfig::getBackupFile();
         
-        if (backupFile.existsAsFile())
+        if (backupFile.exists())
         {
-            backupFile.deleteFile();
+            deleteItem(backupFile);
             UpdaterConfig::logMessage("Backup deleted");
         }
     }
@@ -185,42 +366,123 @@ public:
     }
     
     /**
-     * Extract .zip if downloaded file is zipped
+     * Unpack the plugin from the download if it is an archive (.zip, .gz,
+     * .tar, .tar.gz) into a fresh staging directory.
+     * Returns the plugin (file or bundle root), the file itself if it
+     * isn't archived, or an empty File if the archive can't be unpacked
      */
     static juce::File extractIfNeeded(const juce::File& file)
     {
-        if (file.getFileExtension().equalsIgnoreCase(".zip"))
+        auto staging = UpdaterConfig::getStagingDir();
+        
+        // Leftovers of an earlier attempt must not end up in the bundle
+        if (ArchiveExtractor::getFormat(file.getFileName()) != ArchiveExtractor::Format::plain)
+            staging.deleteRecursively();
+        
+        return ArchiveExtractor::extract(file, staging);
+    }
+    
+    /**
+     * Remove an installed or staged plugin, file or bundle
+     */
+    static bool deleteItem(const juce::File& item)
+    {
+        return !item.exists() || item.deleteRecursively();
+    }
+
+private:
+    /**
+     * Stage every install next to its target, in parallel. A source
+     * shared by several targets is cloned for all but its last install
+     * first; that one then gets the source itself: a rename if it is on
+     * the same volume, otherwise a clone too (one copy at most).
+     */
+    static bool stageAll(const juce::Array<Install>& installs, const InstallJournal::Transaction& journal)
+    {
+        juce::Array<int> clones, moves;
+        
+        for (int i = 0; i < installs.size(); ++i)
+        {
+            bool isLastUse = true;
+        
+            for (int j = i + 1; j < installs.size(); ++j)
+                isLastUse = isLastUse && installs.getReference(j).source != installs.getReference(i).source;
+        
+            (isLastUse ? moves : clones).add(i);
+        }
+        
+        std::vector<FileClone::Method> methods((size_t) installs.size(), FileClone::Method::reflink);
+        std::vector<char> renamed((size_t) installs.size(), 0);
+        std::atomic<bool> failed { false };
+        
+        for (auto* pass : { &clones, &moves })
+        {
+            CopyEngine::forEach(pass->size(), [&](int n)
+            {
+                auto i = pass->getUnchecked(n);
+                auto& source = installs.getReference(i).source;
+                auto& staged = journal.items.getReference(i).staged;
+                
+                if (failed)
+                    return;
+                
+                if (pass == &moves && FileSwap::rename(source, staged))
+                    renamed[(size_t) i] = 1;
+                else if (!FileClone::cloneItem(source, staged, true, &methods[(size_t) i]))
+                    failed = true;
+            });
+            
+            if (failed)
+                return false;
+        }
+        
+        for (int i = 0; i < installs.size(); ++i)
+            UpdaterConfig::logMessage("Staged " + journal.items.getReference(i).target.getFullPathName() + " by " +
+                                    (renamed[(size_t) i] ? juce::String("rename")
+                                                         : FileClone::getName(methods[(size_t) i])));
+        
+        return true;
+    }
+    
+    /**
+     * Remove what was staged, giving moved sources back so a retry
+     * doesn't download them again
+     */
+    static void discardStaged(const juce::Array<Install>& installs, const InstallJournal::Transaction& journal)
+    {
+        for (int i = 0; i < installs.size(); ++i)
         {
-            UpdaterConfig::logMessage("Extracting ZIP file...");
+            auto& source = installs.getReference(i).source;
+            auto& staged = journal.items.getReference(i).staged;
             
-            auto tempDir = UpdaterConfig::getTempDownloadDir();
+            if (!source.exists() && staged.exists())
+                FileSwap::rename(staged, source);
             
-            // Extract ZIP
-            juce::ZipFile zip(file);
+            deleteItem(staged);
+        }
+    }
+    
+    /**
+     * Undo the swaps of the first count items: the old version back at
+     * each target, the new one back at its staging path
+     */
+    static bool unswap(const InstallJournal::Transaction& journal, int count)
+    {
+        bool ok = true;
+        
+        for (int i = count; --i >= 0;)
+        {
+            auto& item = journal.items.getReference(i);
             
-            if (zip.uncompressTo(tempDir).wasOk())
-            {
-                UpdaterConfig::logMessage("ZIP extracted successfully");
-                
-                // Find .vst3 file in extracted files
-                for (int i = 0; i < zip.getNumEntries(); ++i)
-                {
-                    auto entry = zip.getEntry(i);
-                    
-                    if (entry->filename.endsWithIgnoreCase(".vst3"))
-                    {
-                        auto extractedFile = tempDir.getChildFile(entry->filename);
-                        UpdaterConfig::logMessage("Found VST3: " + extractedFile.getFullPathName());
-                        return extractedFile;
-                    }
-                }
-            }
-            else
-            {
-                UpdaterConfig::logMessage("ERROR: Failed to extract ZIP");
-            }
+            ok = (item.oldIdentity != 0 ? FileSwap::install(item.displaced, item.target, item.staged)
+                                        : FileSwap::rename(item.target, item.staged)) && ok;
         }
         
-        return file; // Return original if not ZIP or extraction failed
+        return ok;
+    }
+    
+    static juce::File getSibling(const juce::File& file, const juce::String& suffix)
+    {
+        return file.getSiblingFile(file.getFileName() + suffix);
     }
 };
\ No newline at end of file
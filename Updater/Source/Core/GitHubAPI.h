@@ -2,14 +2,25 @@
   GitHubAPI.h - GitHub Releases API Integration
   
   Handles:
-  - Checking for latest release
-  - Parsing release information
-  - Downloading release files
+  - Syncing the local release index (conditional + gzip, paginated,
+    stops at the first known release)
+  - Answering stable / beta channel queries from that index
+  - Parsing release information (streaming, no JSON DOM)
+  - Downloading release files (parallel byte ranges when supported)
+  - Finding the published SHA-256 of a download (asset digest or sidecar)
 */
 
 #pragma once
 #include <juce_core/juce_core.h>
 #include "../Config.h"
+#include "ArchiveExtractor.h"
+#include "AssetSelector.h"
+#include "ReleaseInfo.h"
+#include "ReleaseIndex.h"
+#include "ReleaseJsonReader.h"
+#include "RequestScheduler.h"
+#include "Downloader.h"
+#include "NetworkEngine.h"
 
 class GitHubAPI
 {
@@ -18,27 +29,7 @@ public:
     // RELEASE INFORMATION
     //==========================================================================
     
-    struct ReleaseInfo
-    {
-        juce::String version;        // e.g., "1.0.1" (without 'v')
-        juce::String tagName;        // e.g., "v1.0.1"
-        juce::String downloadUrl;    // Direct download URL for .vst3 file
-        juce::String changelog;      // Release notes/body
-        juce::Time releaseDate;      // When released
-        bool isPrerelease;           // Is it a beta/prerelease
-        juce::int64 fileSize;        // Size in bytes
-        
-        bool isValid() const 
-        { 
-            return version.isNotEmpty() && downloadUrl.isNotEmpty(); 
-        }
-        
-        juce::String getFileSizeString() const
-        {
-            double mb = fileSize / (1024.0 * 1024.0);
-            return juce::String(mb, 1) + " MB";
-        }
-    };
+    using ReleaseInfo = ::ReleaseInfo;
     
     //==========================================================================
     // PUBLIC API
@@ -46,187 +37,344 @@ public:
     
     /**
      * Check for latest release (synchronous)
+     * Syncs the release index, then answers from it; if the network is
+     * unavailable, the last synced index is used.
      * Returns release info or invalid struct if failed
      */
     static ReleaseInfo getLatestRelease(bool includePrereleases = false)
     {
         UpdaterConfig::logMessage("Checking for latest release...");
         
-        juce::String apiUrl = UpdaterConfig::getGitHubAPIUrl();
-        juce::URL url(apiUrl);
+        if (!syncReleaseIndex() && !ReleaseIndex::isEmpty())
+            UpdaterConfig::logMessage("WARNING: Release sync failed, using local index");
         
-        // Make request (JUCE 8.x simplified API)
-        auto response = url.readEntireTextStream(false);
+        auto info = ReleaseIndex::getLatest(includePrereleases);
         
-        if (response.isEmpty())
-        {
-            UpdaterConfig::logMessage("ERROR: Empty response from GitHub API");
-            return ReleaseInfo();
-        }
-        
-        UpdaterConfig::logMessage("Response received, parsing JSON...");
+        if (info.isValid())
+            UpdaterConfig::logMessage("Latest " + juce::String(includePrereleases ? "beta" : "stable") +
+                                    " release: " + info.version + (info.isPrerelease ? " (prerelease)" : ""));
+        else
+            UpdaterConfig::logMessage("No " + juce::String(includePrereleases ? "" : "stable ") + "release found");
         
-        // Parse JSON
-        auto json = juce::JSON::parse(response);
+        return info;
+    }
+    
+    /**
+     * Bring the local release index up to date.
+     * 
+     * The first page is conditional: if nothing changed it comes back as
+     * 304, which doesn't count against the unauthenticated rate limit.
+     * Otherwise pages are fetched newest first until one contains a
+     * release id the index already knows.
+     * 
+     * Returns: true if the index is current
+     */
+    static bool syncReleaseIndex()
+    {
+        juce::Array<ReleaseInfo> fresh;
+        juce::String etag, lastModified;
         
-        if (json.isVoid())
+        for (int page = 1; page <= UpdaterConfig::RELEASE_MAX_PAGES; ++page)
         {
-            UpdaterConfig::logMessage("ERROR: Failed to parse JSON response");
-            return ReleaseInfo();
+            juce::String headers = "Accept: application/vnd.github+json\r\n"
+                                   "Accept-Encoding: gzip\r\n";
+            
+            if (page == 1)
+                headers << ReleaseIndex::getConditionalHeaders();
+            
+            juce::URL url(UpdaterConfig::getGitHubAPIUrl() +
+                          "?per_page=" + juce::String(UpdaterConfig::RELEASE_PAGE_SIZE) +
+                          "&page=" + juce::String(page));
+            
+            // Rate limits, retries and backoff are handled there
+            auto reply = RequestScheduler::send(url, headers);
+            
+            if (page == 1 && reply.statusCode == 304)
+            {
+                UpdaterConfig::logMessage("Releases unchanged (304), using local index");
+                return true;
+            }
+            
+            if (reply.deferred)
+                return false;
+            
+            if (reply.stream == nullptr || reply.statusCode != 200)
+            {
+                UpdaterConfig::logMessage("ERROR: GitHub API request failed, status " + 
+                                        juce::String(reply.statusCode));
+                return false;
+            }
+            
+            auto response = readResponseBody(*reply.stream);
+            juce::Array<ReleaseInfo> releases;
+            
+            if (!parseReleaseList(response, releases))
+                return false;
+            
+            if (page == 1)
+            {
+                etag = reply.headers.getValue("ETag", {});
+                lastModified = reply.headers.getValue("Last-Modified", {});
+            }
+            
+            bool reachedKnown = false;
+            
+            for (auto& release : releases)
+                reachedKnown = reachedKnown || ReleaseIndex::contains(release.id);
+            
+            fresh.addArray(releases);
+            
+            if (reachedKnown || releases.size() < UpdaterConfig::RELEASE_PAGE_SIZE)
+                break;
         }
         
-        return parseReleaseInfo(json, includePrereleases);
+        UpdaterConfig::logMessage("Release index synced: " + juce::String(fresh.size()) + " releases fetched");
+        
+        ReleaseIndex::merge(fresh, etag, lastModified);
+        return true;
     }
     
     /**
      * Check for latest release (asynchronous with callback)
+     * Runs on the NetworkEngine, callback is called on message thread
      */
     static void getLatestReleaseAsync(
         std::function<void(ReleaseInfo)> callback,
         bool includePrereleases = false)
     {
-        juce::Thread::launch([callback, includePrereleases]()
-        {
-            auto info = getLatestRelease(includePrereleases);
-            
-            // Call callback on message thread
-            juce::MessageManager::callAsync([callback, info]()
+        NetworkEngine::getInstance().submit(nullptr,
+            [includePrereleases]
             {
-                callback(info);
-            });
-        });
+                return getLatestRelease(includePrereleases);
+            },
+            callback);
     }
     
     /**
      * Download file from URL with progress callback
      * 
-     * progressCallback: void(float progress, int bytesDownloaded, int totalBytes)
-     * Returns: true if successful
+     * progressCallback: void(int64 bytesDownloaded, int64 totalBytes), called on the download thread
+     * expectedSha256 / expectedSize: checked while the bytes stream in (empty / -1 to skip)
+     * mirrors: other URLs of the same file (see getMirrorUrls)
+     * Returns: true if successful (and verified)
      */
     static bool downloadFile(
         const juce::String& url,
         const juce::File& destination,
-        std::function<void(float, int, int)> progressCallback = nullptr)
+        Downloader::ProgressCallback progressCallback = nullptr,
+        const juce::String& expectedSha256 = {},
+        juce::int64 expectedSize = -1,
+        const juce::StringArray& mirrors = {})
     {
-        UpdaterConfig::logMessage("Downloading: " + url);
-        UpdaterConfig::logMessage("To: " + destination.getFullPathName());
+        Downloader downloader(url, destination, 
+                              UpdaterConfig::DOWNLOAD_SEGMENTS, 
+                              std::move(progressCallback));
         
-        juce::URL downloadUrl(url);
+        downloader.setExpected(expectedSha256, expectedSize);
+        downloader.setMirrors(mirrors);
+        return downloader.run();
+    }
+    
+    /**
+     * Download an archive and unpack it into destDir as it arrives,
+     * without saving the archive itself (see ArchiveExtractor::canStream).
+     * The archive is verified like downloadFile once it has been read.
+     * Returns: the plugin inside, or an empty File on failure (destDir
+     * may then hold a partial extraction).
+     */
+    static juce::File downloadAndExtract(
+        const juce::String& url,
+        const juce::File& destDir,
+        Downloader::ProgressCallback progressCallback = nullptr,
+        const juce::String& expectedSha256 = {},
+        juce::int64 expectedSize = -1,
+        const juce::StringArray& mirrors = {})
+    {
+        auto fileName = juce::URL::removeEscapeChars(url.fromLastOccurrenceOf("/", false, false));
+        juce::File plugin;
         
-        // Create output stream
-        auto outputStream = destination.createOutputStream();
+        Downloader downloader(url, destDir.getChildFile(fileName), 1, std::move(progressCallback));
+        downloader.setExpected(expectedSha256, expectedSize);
+        downloader.setMirrors(mirrors);
         
-        if (!outputStream)
+        auto ok = downloader.runStreamed([&](juce::InputStream& in)
         {
-            UpdaterConfig::logMessage("ERROR: Failed to create output stream");
-            return false;
-        }
+            plugin = ArchiveExtractor::extractStream(in, fileName, destDir);
+            return plugin != juce::File();
+        });
+        
+        return ok ? plugin : juce::File();
+    }
+    
+    /**
+     * Published SHA-256 (lowercase hex) of the release download.
+     * Uses the asset digest from the API when present, otherwise fetches
+     * the ".sha256" sidecar asset. Returns empty if none is published.
+     */
+    static juce::String getExpectedSha256(const ReleaseInfo& release)
+    {
+        if (release.sha256.isNotEmpty() || release.checksumUrl.isEmpty())
+            return release.sha256;
+        
+        int statusCode = 0;
         
-        // Create input stream with progress callback (JUCE 8.x uses int, int)
-        auto inputStream = downloadUrl.createInputStream(
+        auto stream = juce::URL(release.checksumUrl).createInputStream(
             juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
-                .withProgressCallback([progressCallback](int bytesDownloaded, int totalBytes)
-                {
-                    if (progressCallback && totalBytes > 0)
-                    {
-                        float progress = (float)bytesDownloaded / (float)totalBytes;
-                        progressCallback(progress, bytesDownloaded, totalBytes);
-                    }
-                    return true; // Continue download
-                })
+                .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                .withStatusCode(&statusCode)
         );
         
-        if (!inputStream)
+        if (stream == nullptr || statusCode != 200)
         {
-            UpdaterConfig::logMessage("ERROR: Failed to create input stream");
-            return false;
+            UpdaterConfig::logMessage("WARNING: Failed to fetch checksum file, status " +
+                                    juce::String(statusCode));
+            return {};
         }
         
-        // Download
-        auto bytesWritten = outputStream->writeFromInputStream(*inputStream, -1);
+        // "<hex>  <filename>" (sha256sum format) or just "<hex>"
+        auto digest = parseSha256(stream->readString().trim().upToFirstOccurrenceOf(" ", false, false));
         
-        if (bytesWritten > 0)
-        {
-            UpdaterConfig::logMessage("Download complete: " + 
-                                    juce::String(bytesWritten) + " bytes");
-            return true;
-        }
-        else
-        {
-            UpdaterConfig::logMessage("ERROR: Download failed, 0 bytes written");
-            return false;
-        }
+        if (digest.isEmpty())
+            UpdaterConfig::logMessage("WARNING: Checksum file has no valid SHA-256");
+        
+        return digest;
     }
     
+    //==========================================================================
+    // ASSET HELPERS
+    //==========================================================================
+    
+    /**
+     * Accepts "sha256:<hex>" (API digest field) or bare hex
+     * Returns lowercase hex, or empty if it isn't a SHA-256
+     */
+    static juce::String parseSha256(juce::String text)
+    {
+        text = text.trim();
+        
+        if (text.startsWithIgnoreCase("sha256:"))
+            text = text.substring(7);
+        
+        if (text.length() != 64 || !text.containsOnly("0123456789abcdefABCDEF"))
+            return {};
+        
+        return text.toLowerCase();
+    }
+    
+    /**
+     * URLs of a release asset on the configured mirrors:
+     * <mirror>/<tag>/<asset file name>
+     */
+    static juce::StringArray getMirrorUrls(const ReleaseInfo& release, const juce::String& assetUrl)
+    {
+        juce::StringArray urls;
+        auto fileName = juce::URL(assetUrl).getFileName();
+        
+        if (release.tagName.isEmpty() || fileName.isEmpty())
+            return urls;
+        
+        for (auto& mirror : UpdaterConfig::getAssetMirrors())
+            urls.add(mirror + "/" + juce::URL::addEscapeChars(release.tagName, false) +
+                     "/" + fileName);
+        
+        return urls;
+    }
+    
+    static bool isChecksumAsset(const juce::String& name)
+    {
+        return name.endsWithIgnoreCase(".sha256") || name.endsWithIgnoreCase(".sha256sum");
+    }
+    
+    /**
+     * Delta patch assets: "<anything>.from-<version or hash prefix>.patch"
+     */
+    static bool isPatchAsset(const juce::String& name)
+    {
+        return name.endsWithIgnoreCase(".patch") && name.containsIgnoreCase(".from-");
+    }
+
 private:
     //==========================================================================
     // PARSING
     //==========================================================================
     
-    static ReleaseInfo parseReleaseInfo(const juce::var& json, bool includePrereleases)
+    /**
+     * Read whole response body, inflating it if the server sent gzip.
+     * Detected by magic bytes rather than Content-Encoding, since some
+     * platform backends already decode transparently.
+     */
+    static juce::MemoryBlock readResponseBody(juce::InputStream& stream)
     {
-        ReleaseInfo info;
+        juce::MemoryBlock raw;
+        stream.readIntoMemoryBlock(raw);
         
-        if (auto* obj = json.getDynamicObject())
+        if (raw.getSize() >= 2 
+            && (juce::uint8) raw[0] == 0x1f 
+            && (juce::uint8) raw[1] == 0x8b)
         {
-            // Check if prerelease
-            info.isPrerelease = obj->getProperty("prerelease");
-            
-            if (info.isPrerelease && !includePrereleases)
-            {
-                UpdaterConfig::logMessage("Skipping prerelease");
-                return ReleaseInfo();
-            }
+            juce::MemoryInputStream compressed(raw, false);
+            juce::GZIPDecompressorInputStream gzip(&compressed, false,
+                juce::GZIPDecompressorInputStream::gzipFormat);
             
-            // Get version
-            info.tagName = obj->getProperty("tag_name").toString();
-            info.version = info.tagName.trimCharactersAtStart("v");
+            juce::MemoryBlock inflated;
+            gzip.readIntoMemoryBlock(inflated);
             
-            // Get changelog
-            info.changelog = obj->getProperty("body").toString();
-            
-            // Get release date
-            juce::String dateStr = obj->getProperty("published_at").toString();
-            info.releaseDate = juce::Time::fromISO8601(dateStr);
-            
-            // Find .vst3 asset in assets array
-            auto assets = obj->getProperty("assets");
-            
-            if (auto* arr = assets.getArray())
-            {
-                for (auto& asset : *arr)
-                {
-                    if (auto* assetObj = asset.getDynamicObject())
-                    {
-                        juce::String name = assetObj->getProperty("name").toString();
-                        
-                        // Look for .vst3 or .vst3.zip file
-                        if (name.endsWithIgnoreCase(".vst3") || 
-                            name.endsWithIgnoreCase(".vst3.zip") ||
-                            name.containsIgnoreCase("samp"))
-                        {
-                            info.downloadUrl = assetObj->getProperty("browser_download_url").toString();
-                            info.fileSize = assetObj->getProperty("size");
-                            
-                            UpdaterConfig::logMessage("Found asset: " + name);
-                            UpdaterConfig::logMessage("URL: " + info.downloadUrl);
-                            UpdaterConfig::logMessage("Size: " + info.getFileSizeString());
-                            
-                            break;
-                        }
-                    }
-                }
-            }
-            
-            if (info.downloadUrl.isEmpty())
-            {
-                UpdaterConfig::logMessage("WARNING: No .vst3 asset found in release");
-            }
-            
-            UpdaterConfig::logMessage("Parsed release: " + info.version + 
-                                    (info.isPrerelease ? " (prerelease)" : ""));
+            UpdaterConfig::logMessage("Response gzip: " + juce::String((juce::int64) raw.getSize()) +
+                                    " -> " + juce::String((juce::int64) inflated.getSize()) + " bytes");
+            return inflated;
         }
         
-        return info;
+        return raw;
+    }
+    
+    static bool parseReleaseList(const juce::MemoryBlock& response, juce::Array<ReleaseInfo>& releases)
+    {
+        juce::MemoryInputStream stream(response, false);
+        ReleaseJsonReader reader(stream);
+        
+        if (!reader.readReleaseList(releases))
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to parse JSON response");
+            return false;
+        }
+        
+        for (auto& info : releases)
+            selectAsset(info);
+        
+        return true;
+    }
+    
+    /**
+     * Pick the installable asset of a release (and its published digest)
+     */
+    static void selectAsset(ReleaseInfo& info)
+    {
+        juce::Array<ReleaseInfo::Asset> candidates;
+        
+        for (auto& asset : info.assets)
+            if (!isChecksumAsset(asset.name) && !isPatchAsset(asset.name)
+                && !asset.name.endsWithIgnoreCase(".blockmap"))
+                candidates.add(asset);
+        
+        // Platform + architecture match first, then the smallest encoding
+        auto index = AssetSelector::choose(candidates);
+        
+        if (index < 0)
+        {
+            UpdaterConfig::logMessage("WARNING: No .vst3 asset for this platform in release " + info.tagName);
+            return;
+        }
+        
+        auto& asset = candidates.getReference(index);
+        info.downloadUrl = asset.downloadUrl;
+        info.fileSize = asset.size;
+        info.sha256 = parseSha256(asset.digest);
+        
+        // Older releases have no digest field; look for a sidecar
+        if (info.sha256.isEmpty())
+            for (auto& other : info.assets)
+                if (isChecksumAsset(other.name)
+                    && other.name.upToLastOccurrenceOf(".", false, false).equalsIgnoreCase(asset.name))
+                    info.checksumUrl = other.downloadUrl;
     }
 };
\ No newline at end of file
@@ -0,0 +1,509 @@
+/*
+  Inflate.h - Raw DEFLATE decoder (RFC 1951) and CRC-32
+  
+  juce::GZIPDecompressorInputStream reads its source in large chunks,
+  so it can't say where a deflate stream ends. Zip entries written with
+  a data descriptor (as Compress-Archive does) only reveal their size
+  after the data, so a streaming zip reader has to find the end itself.
+  This decoder pulls input on demand, stops exactly at the end of the
+  final block and hands unused bytes back to the caller.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <functional>
+
+//==============================================================================
+class Crc32
+{
+public:
+    void reset() { crc = 0xffffffffu; }
+    
+    void update(const void* data, size_t numBytes)
+    {
+        auto* table = getTable();
+        auto* bytes = static_cast<const juce::uint8*>(data);
+        auto c = crc;
+        
+        for (size_t i = 0; i < numBytes; ++i)
+            c = table[(c ^ bytes[i]) & 0xff] ^ (c >> 8);
+        
+        crc = c;
+    }
+    
+    juce::uint32 get() const { return crc ^ 0xffffffffu; }
+
+private:
+    static const juce::uint32* getTable()
+    {
+        struct Table
+        {
+            juce::uint32 values[256];
+            
+            Table()
+            {
+                for (juce::uint32 n = 0; n < 256; ++n)
+                {
+                    auto c = n;
+                    
+                    for (int k = 0; k < 8; ++k)
+                        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    
+                    values[n] = c;
+                }
+            }
+        };
+        
+        static const Table table;
+        return table.values;
+    }
+    
+    juce::uint32 crc = 0xffffffffu;
+};
+
+//==============================================================================
+class Inflater
+{
+public:
+    /**
+     * Input window. When next reaches end, refill is asked to point them
+     * at more bytes (returning false at end of data). A refill must keep
+     * the 8 bytes before next readable: unused look-ahead is handed back
+     * by moving next backwards.
+     */
+    struct Input
+    {
+        const juce::uint8* next = nullptr;
+        const juce::uint8* end = nullptr;
+        std::function<bool(Input&)> refill;
+    };
+    
+    /**
+     * Receives decoded bytes in order; return false to stop
+     */
+    using Output = std::function<bool(const juce::uint8*, size_t)>;
+    
+    enum class Result
+    {
+        ok,
+        truncated,      // Input ended before the final block
+        corrupt,        // Not valid deflate data
+        outputFailed    // Output returned false
+    };
+    
+    /**
+     * Decode one raw deflate stream. On return input.next is just past
+     * its last byte (when ok).
+     */
+    Result run(Input& input, const Output& output)
+    {
+        in = &input;
+        out = &output;
+        bitBuffer = 0;
+        bitCount = 0;
+        missingBytes = 0;
+        position = 0;
+        flushed = 0;
+        written = false;
+        
+        if (window.getData() == nullptr)
+            window.malloc(windowSize);
+        
+        auto result = Result::ok;
+        
+        for (bool last = false; !last && result == Result::ok;)
+        {
+            last = bits(1) != 0;
+            
+            switch (bits(2))
+            {
+                case 0:  result = storedBlock(); break;
+                case 1:  result = codesBlock(getFixedTables().lengths, getFixedTables().distances); break;
+                case 2:  result = dynamicBlock(); break;
+                default: result = Result::corrupt; break;
+            }
+            
+            if (missingBytes > maxMissing && result == Result::ok)
+                result = Result::truncated;
+        }
+        
+        if (result != Result::ok)
+            return result;
+        
+        if (!flush())
+            return Result::outputFailed;
+        
+        // Hand back whole bytes that were read ahead
+        auto unused = bitCount / 8 - missingBytes;
+        
+        if (unused < 0)
+            return Result::truncated;
+        
+        in->next -= unused;
+        bitBuffer = 0;
+        bitCount = 0;
+        return Result::ok;
+    }
+
+private:
+    static constexpr int windowSize = 1 << 16;      // Twice the deflate window
+    static constexpr int fastBits = 9;
+    static constexpr int maxMissing = 4;    // Look-ahead past the end; more means truncated
+    
+    //==========================================================================
+    // HUFFMAN TABLES
+    //==========================================================================
+    
+    struct Huffman
+    {
+        juce::int16 count[16] {};
+        juce::int16 symbol[320] {};
+        juce::uint16 fast[1 << fastBits] {};   // (length << 12) | symbol, 0 = use slow path
+        
+        bool build(const juce::uint8* lengths, int numSymbols)
+        {
+            std::fill(std::begin(count), std::end(count), (juce::int16) 0);
+            std::fill(std::begin(fast), std::end(fast), (juce::uint16) 0);
+            
+            for (int s = 0; s < numSymbols; ++s)
+                ++count[lengths[s]];
+            
+            if (count[0] == numSymbols)
+                return true;    // No codes (e.g. no distances): fine until one is used
+            
+            int left = 1;
+            
+            for (int len = 1; len < 16; ++len)
+            {
+                left = (left << 1) - count[len];
+                
+                if (left < 0)
+                    return false;   // Over-subscribed
+            }
+            
+            juce::int16 offsets[16] {};
+            
+            for (int len = 1; len < 15; ++len)
+                offsets[len + 1] = (juce::int16) (offsets[len] + count[len]);
+            
+            for (int s = 0; s < numSymbols; ++s)
+                if (lengths[s] != 0)
+                    symbol[offsets[lengths[s]]++] = (juce::int16) s;
+            
+            // Canonical codes, bit-reversed into the fast table
+            int code = 0, index = 0;
+            
+            for (int len = 1; len <= fastBits; ++len)
+            {
+                for (int i = 0; i < count[len]; ++i, ++code, ++index)
+                {
+                    auto reversed = reverse(code, len);
+                    
+                    for (int fill = reversed; fill < (1 << fastBits); fill += 1 << len)
+                        fast[fill] = (juce::uint16) ((len << 12) | symbol[index]);
+                }
+                
+                code <<= 1;
+            }
+            
+            return true;
+        }
+        
+        static int reverse(int code, int length)
+        {
+            int result = 0;
+            
+            for (int i = 0; i < length; ++i, code >>= 1)
+                result = (result << 1) | (code & 1);
+            
+            return result;
+        }
+    };
+    
+    struct FixedTables
+    {
+        Huffman lengths, distances;
+        
+        FixedTables()
+        {
+            juce::uint8 l[288];
+            
+            for (int s = 0; s < 288; ++s)
+                l[s] = (juce::uint8) (s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8);
+            
+            lengths.build(l, 288);
+            
+            juce::uint8 d[30];
+            std::fill(std::begin(d), std::end(d), (juce::uint8) 5);
+            distances.build(d, 30);
+        }
+    };
+    
+    static const FixedTables& getFixedTables()
+    {
+        static const FixedTables tables;
+        return tables;
+    }
+    
+    //==========================================================================
+    // BITS
+    //==========================================================================
+    
+    juce::uint8 pull()
+    {
+        if (in->next == in->end && !(in->refill && in->refill(*in)))
+        {
+            // Keep decoding with zeros; checked once the block is done
+            ++missingBytes;
+            return 0;
+        }
+        
+        return *in->next++;
+    }
+    
+    void need(int n)
+    {
+        while (bitCount < n)
+        {
+            bitBuffer |= (juce::uint64) pull() << bitCount;
+            bitCount += 8;
+        }
+    }
+    
+    int bits(int n)
+    {
+        need(n);
+        auto value = (int) (bitBuffer & ((1u << n) - 1));
+        bitBuffer >>= n;
+        bitCount -= n;
+        return value;
+    }
+    
+    int decode(const Huffman& h)
+    {
+        need(fastBits);
+        auto entry = h.fast[bitBuffer & ((1u << fastBits) - 1)];
+        
+        if (entry != 0)
+        {
+            auto length = entry >> 12;
+            bitBuffer >>= length;
+            bitCount -= length;
+            return entry & 0xfff;
+        }
+        
+        // Longer codes: canonical decode one bit at a time
+        int code = 0, first = 0, index = 0;
+        
+        for (int len = 1; len < 16; ++len)
+        {
+            code |= bits(1);
+            auto count = h.count[len];
+            
+            if (code - count < first)
+                return h.symbol[index + (code - first)];
+            
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        
+        return -1;
+    }
+    
+    //==========================================================================
+    // OUTPUT
+    //==========================================================================
+    
+    bool emit(juce::uint8 byte)
+    {
+        window[position++] = byte;
+        
+        if (position == windowSize)
+        {
+            if (!(*out)(window.getData() + flushed, (size_t) (windowSize - flushed)))
+                return false;
+            
+            position = 0;
+            flushed = 0;
+            written = true;
+        }
+        
+        return true;
+    }
+    
+    bool flush()
+    {
+        bool ok = position <= flushed || (*out)(window.getData() + flushed, (size_t) (position - flushed));
+        flushed = position;
+        return ok;
+    }
+    
+    //==========================================================================
+    // BLOCKS
+    //==========================================================================
+    
+    Result storedBlock()
+    {
+        // Skip to a byte boundary
+        bitBuffer >>= bitCount % 8;
+        bitCount -= bitCount % 8;
+        
+        auto length = bits(16);
+        auto complement = bits(16);
+        
+        if (length != (~complement & 0xffff))
+            return Result::corrupt;
+        
+        while (length-- > 0)
+        {
+            if (!emit((juce::uint8) bits(8)))
+                return Result::outputFailed;
+            
+            if (missingBytes > maxMissing)
+                return Result::truncated;
+        }
+        
+        return Result::ok;
+    }
+    
+    Result codesBlock(const Huffman& lengthCodes, const Huffman& distanceCodes)
+    {
+        static constexpr juce::int16 lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static constexpr juce::int16 lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static constexpr juce::int32 distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                          257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                                          8193, 12289, 16385, 24577 };
+        static constexpr juce::int16 distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                           7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        
+        for (;;)
+        {
+            auto symbol = decode(lengthCodes);
+            
+            if (symbol < 0 || missingBytes > maxMissing)
+                return missingBytes > maxMissing ? Result::truncated : Result::corrupt;
+            
+            if (symbol < 256)
+            {
+                if (!emit((juce::uint8) symbol))
+                    return Result::outputFailed;
+                
+                continue;
+            }
+            
+            if (symbol == 256)
+                return Result::ok;
+            
+            symbol -= 257;
+            
+            if (symbol >= 29)
+                return Result::corrupt;
+            
+            auto length = lengthBase[symbol] + bits(lengthExtra[symbol]);
+            auto distanceSymbol = decode(distanceCodes);
+            
+            if (distanceSymbol < 0 || distanceSymbol >= 30)
+                return Result::corrupt;
+            
+            auto distance = distanceBase[distanceSymbol] + bits(distanceExtra[distanceSymbol]);
+            
+            if (distance > totalOut())
+                return Result::corrupt;
+            
+            while (length-- > 0)
+                if (!emit(window[(position - distance) & (windowSize - 1)]))
+                    return Result::outputFailed;
+        }
+    }
+    
+    Result dynamicBlock()
+    {
+        static constexpr int order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        
+        auto numLengths = bits(5) + 257;
+        auto numDistances = bits(5) + 1;
+        auto numCodeLengths = bits(4) + 4;
+        
+        if (numLengths > 286 || numDistances > 30)
+            return Result::corrupt;
+        
+        juce::uint8 lengths[320] {};
+        
+        for (int i = 0; i < numCodeLengths; ++i)
+            lengths[order[i]] = (juce::uint8) bits(3);
+        
+        Huffman codeLengths;
+        
+        if (!codeLengths.build(lengths, 19))
+            return Result::corrupt;
+        
+        for (int i = 0; i < numLengths + numDistances;)
+        {
+            auto symbol = decode(codeLengths);
+            
+            if (symbol < 0)
+                return Result::corrupt;
+            
+            if (symbol < 16)
+            {
+                lengths[i++] = (juce::uint8) symbol;
+                continue;
+            }
+            
+            juce::uint8 value = 0;
+            int repeat = 0;
+            
+            if (symbol == 16)
+            {
+                if (i == 0)
+                    return Result::corrupt;
+                
+                value = lengths[i - 1];
+                repeat = 3 + bits(2);
+            }
+            else
+            {
+                repeat = symbol == 17 ? 3 + bits(3) : 11 + bits(7);
+            }
+            
+            if (i + repeat > numLengths + numDistances)
+                return Result::corrupt;
+            
+            while (repeat-- > 0)
+                lengths[i++] = value;
+        }
+        
+        if (lengths[256] == 0)
+            return Result::corrupt;     // No end-of-block code
+        
+        Huffman lengthCodes, distanceCodes;
+        
+        if (!lengthCodes.build(lengths, numLengths)
+            || !distanceCodes.build(lengths + numLengths, numDistances))
+            return Result::corrupt;
+        
+        return codesBlock(lengthCodes, distanceCodes);
+    }
+    
+    juce::int64 totalOut() const
+    {
+        // Only how much history exists matters, and that saturates at the window
+        return written || position >= 32768 ? 32768 : position;
+    }
+    
+    //==========================================================================
+    
+    Input* in = nullptr;
+    const Output* out = nullptr;
+    juce::uint64 bitBuffer = 0;
+    int bitCount = 0;
+    int missingBytes = 0;      // Zero bytes made up past the end of input
+    
+    juce::HeapBlock<juce::uint8> window;
+    int position = 0;       // Next write in window
+    int flushed = 0;        // window[flushed, position) not yet output
+    bool written = false;   // Window has wrapped at least once
+};
\ No newline at end of file
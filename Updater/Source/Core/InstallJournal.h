@@ -0,0 +1,353 @@
+/*
+  InstallJournal.h - Write-ahead log for plugin installs
+  
+  Each install (update, restore, version switch) is one transaction,
+  covering every target it installs to. Its steps are appended to a
+  small journal and flushed to disk before the step they describe
+  happens:
+    begin    per target: the three paths involved and the identity of
+             what is installed there
+    staged   every new version is complete next to its target
+    swapped  every new version is at its target
+  The journal is deleted when the transaction ends, so an existing
+  journal at startup means an install was interrupted.
+  
+  recover() then only looks at the paths the journal names. Files are
+  told apart by their file identifier (inode / NTFS file index), which a
+  rename keeps. A transaction that got as far as "staged" is completed
+  at all of its targets (the new versions were fully written); anything
+  earlier is rolled back everywhere to the versions that were installed.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "FileSwap.h"
+
+class InstallJournal
+{
+public:
+    /**
+     * One target of a transaction
+     */
+    struct Item
+    {
+        juce::File target;              // Installed item
+        juce::File staged;              // New version, next to the target
+        juce::File displaced;           // Where the old version goes
+        bool keepDisplaced = false;     // Old version is the backup, or is dropped
+        juce::uint64 oldIdentity = 0;   // What was at target (0 = nothing)
+        juce::uint64 newIdentity = 0;   // The staged version, once complete
+    };
+    
+    struct Transaction
+    {
+        juce::String id;                // Empty: not journaled
+        juce::Array<Item> items;
+        bool isStaged = false;
+        bool isSwapped = false;
+        
+        bool isValid() const { return id.isNotEmpty(); }
+    };
+    
+    /**
+     * Start a transaction over items (target, staged, displaced and
+     * keepDisplaced set). Call before anything at a target or a staging
+     * path is touched.
+     */
+    static Transaction begin(const juce::Array<Item>& items)
+    {
+        Transaction tx;
+        tx.id = juce::String::toHexString(juce::Random::getSystemRandom().nextInt64());
+        tx.items = items;
+        
+        juce::Array<juce::StringArray> records;
+        records.add({ "begin", tx.id, juce::String(items.size()) });
+        
+        for (auto& item : tx.items)
+        {
+            item.oldIdentity = item.target.exists() ? item.target.getFileIdentifier() : 0;
+            
+            records.add({ "item", tx.id, item.target.getFullPathName(), item.staged.getFullPathName(),
+                          item.displaced.getFullPathName(), item.keepDisplaced ? "1" : "0",
+                          toHex(item.oldIdentity) });
+        }
+        
+        // A fresh journal per transaction; installs don't overlap
+        getJournalFile().deleteFile();
+        
+        // All targets in one write: a single flush however many there are
+        if (!append(records))
+        {
+            UpdaterConfig::logMessage("WARNING: Install journal not writable, continuing without it");
+            tx.id.clear();
+        }
+        
+        return tx;
+    }
+    
+    /**
+     * Single-target transaction
+     */
+    static Transaction begin(const juce::File& target, const juce::File& staged,
+                             const juce::File& displaced, bool keepDisplaced)
+    {
+        Item item;
+        item.target = target;
+        item.staged = staged;
+        item.displaced = displaced;
+        item.keepDisplaced = keepDisplaced;
+        return begin(juce::Array<Item> { item });
+    }
+    
+    /**
+     * Every new version is completely written at its staging path. One
+     * record for all targets, so either all of them roll forward or none.
+     */
+    static void markStaged(Transaction& tx)
+    {
+        juce::StringArray record { "staged", tx.id };
+        
+        for (auto& item : tx.items)
+        {
+            item.newIdentity = item.staged.getFileIdentifier();
+            record.add(toHex(item.newIdentity));
+        }
+        
+        tx.isStaged = true;
+        
+        if (tx.isValid())
+            append({ record });
+    }
+    
+    static void markSwapped(Transaction& tx)
+    {
+        tx.isSwapped = true;
+        
+        if (tx.isValid())
+            append({ { "swapped", tx.id } });
+    }
+    
+    /**
+     * The transaction is over, whichever way it went
+     */
+    static void finish(const Transaction& tx)
+    {
+        if (tx.isValid())
+            getJournalFile().deleteFile();
+    }
+    
+    //==========================================================================
+    // RECOVERY
+    //==========================================================================
+    
+    /**
+     * Complete or roll back an install interrupted by a crash or power
+     * loss. Call at startup, before anything else installs. Returns
+     * false if the journal's transaction couldn't be resolved (the
+     * journal is then kept for the next attempt).
+     */
+    static bool recover()
+    {
+        auto journalFile = getJournalFile();
+        
+        if (!journalFile.existsAsFile())
+            return true;
+        
+        auto tx = read(journalFile);
+        
+        if (!tx.isValid())
+        {
+            // Torn before "begin" was written: nothing had been touched
+            journalFile.deleteFile();
+            return true;
+        }
+        
+        auto startMs = juce::Time::getMillisecondCounterHiRes();
+        UpdaterConfig::logMessage("Interrupted install found (" + juce::String(tx.isSwapped ? "swapped"
+                                                                              : tx.isStaged ? "staged" : "begun") +
+                                ", " + juce::String(tx.items.size()) + " target(s))");
+        
+        bool ok = true;
+        
+        // Every target, even after one fails: the others still need resolving
+        for (auto& item : tx.items)
+            ok = (tx.isStaged ? rollForward(item) : rollBack(item)) && ok;
+        
+        UpdaterConfig::logMessage(juce::String(ok ? "Install " : "ERROR: Could not ") +
+                                (tx.isStaged ? "completed" : "rolled back") + " in " +
+                                juce::String(juce::roundToInt(juce::Time::getMillisecondCounterHiRes() - startMs)) + " ms");
+        
+        if (ok)
+            journalFile.deleteFile();
+        
+        return ok;
+    }
+
+private:
+    static juce::File getJournalFile()
+    {
+        return UpdaterConfig::getInstallJournalFile();
+    }
+    
+    /**
+     * Tab-separated records, one per line, flushed (and synced) together
+     * before returning
+     */
+    static bool append(const juce::Array<juce::StringArray>& records)
+    {
+        auto file = getJournalFile();
+        file.getParentDirectory().createDirectory();
+        
+        juce::FileOutputStream out(file);
+        
+        if (out.failedToOpen())
+            return false;
+        
+        for (auto& fields : records)
+            out.writeText(fields.joinIntoString("\t") + "\n", false, false, nullptr);
+        
+        out.flush();
+        return out.getStatus().wasOk();
+    }
+    
+    /**
+     * A torn last line (cut off by the crash) has too few fields and is
+     * ignored. A transaction is only valid once all its items are read.
+     */
+    static Transaction read(const juce::File& file)
+    {
+        Transaction tx;
+        juce::String id;
+        int numItems = 0;
+        
+        for (auto& line : juce::StringArray::fromLines(file.loadFileAsString()))
+        {
+            juce::StringArray fields;
+            fields.addTokens(line, "\t", "");
+            
+            if (fields[0] == "begin" && fields.size() == 3)
+            {
+                id = fields[1];
+                numItems = fields[2].getIntValue();
+            }
+            else if (fields[0] == "begin" && fields.size() == 7)
+            {
+                // Written by a single-target version of the updater
+                id = fields[1];
+                numItems = 1;
+                tx.items.add(readItem(fields, 2));
+            }
+            else if (id.isEmpty() || fields[1] != id)
+            {
+                continue;
+            }
+            else if (fields[0] == "item" && fields.size() == 7)
+            {
+                tx.items.add(readItem(fields, 2));
+            }
+            else if (fields[0] == "staged" && fields.size() == 2 + tx.items.size() && tx.isValid())
+            {
+                tx.isStaged = true;
+                
+                for (int i = 0; i < tx.items.size(); ++i)
+                {
+                    auto& item = tx.items.getReference(i);
+                    item.newIdentity = (juce::uint64) fields[2 + i].getHexValue64();
+                    tx.isStaged = tx.isStaged && item.newIdentity != 0;
+                }
+            }
+            else if (fields[0] == "swapped" && fields.size() == 2)
+            {
+                tx.isSwapped = true;
+            }
+            
+            if (numItems > 0 && tx.items.size() == numItems)
+                tx.id = id;
+        }
+        
+        return tx;
+    }
+    
+    static Item readItem(const juce::StringArray& fields, int start)
+    {
+        Item item;
+        item.target = juce::File(fields[start]);
+        item.staged = juce::File(fields[start + 1]);
+        item.displaced = juce::File(fields[start + 2]);
+        item.keepDisplaced = fields[start + 3] == "1";
+        item.oldIdentity = (juce::uint64) fields[start + 4].getHexValue64();
+        return item;
+    }
+    
+    /**
+     * The new version was complete: put it at the target, and the old
+     * one at displaced (or nowhere)
+     */
+    static bool rollForward(const Item& item)
+    {
+        if (!isAt(item.target, item.newIdentity))
+        {
+            if (!isAt(item.staged, item.newIdentity))
+            {
+                // The new version is gone; make sure the old one is installed
+                UpdaterConfig::logMessage("WARNING: Staged version missing, rolling back");
+                return rollBack(item);
+            }
+            
+            // The old version is at the target, or already at displaced
+            bool moved = item.target.exists() ? FileSwap::install(item.staged, item.target, item.displaced)
+                                              : FileSwap::rename(item.staged, item.target);
+            
+            if (!moved)
+                return false;
+        }
+        
+        // An atomic swap leaves the old version at the staging path
+        if (item.oldIdentity != 0 && isAt(item.staged, item.oldIdentity))
+            FileSwap::rename(item.staged, item.displaced);
+        
+        if (!item.keepDisplaced && isAt(item.displaced, item.oldIdentity))
+            item.displaced.deleteRecursively();
+        
+        return true;
+    }
+    
+    /**
+     * The new version wasn't complete: drop it and make sure the old
+     * one is at the target
+     */
+    static bool rollBack(const Item& item)
+    {
+        if (item.staged.exists() && !isAt(item.staged, item.oldIdentity))
+            item.staged.deleteRecursively();
+        
+        if (item.oldIdentity == 0 || isAt(item.target, item.oldIdentity))
+            return true;
+        
+        for (auto& place : { item.displaced, item.staged })
+        {
+            if (isAt(place, item.oldIdentity))
+            {
+                // Whatever sits at the target now is not the old version
+                if (item.target.exists())
+                    item.target.deleteRecursively();
+                
+                return FileSwap::rename(place, item.target);
+            }
+        }
+        
+        UpdaterConfig::logMessage("ERROR: Previously installed version not found");
+        return false;
+    }
+    
+    static juce::String toHex(juce::uint64 identity)
+    {
+        return juce::String::toHexString((juce::int64) identity);
+    }
+    
+    static bool isAt(const juce::File& file, juce::uint64 identity)
+    {
+        return identity != 0 && file.exists() && file.getFileIdentifier() == identity;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,467 @@
+/*
+  InstallStore.h - Retained plugin versions, stored by content
+  
+  Every installed version is recorded as a generation: a manifest
+  listing each file of the plugin with its SHA-256, size and whether it
+  is executable. The files themselves are kept once under objects/,
+  named by their hash, so versions that share files (resources, an
+  unchanged binary) share the space. The store sits on the plugin's
+  volume and objects are hard links of the installed files, so
+  recording a version copies nothing.
+  
+  Switching to a retained version rebuilds its tree from the objects
+  with hard links (reflinks or copies where links aren't supported) and
+  renames it into place: no download. The newest
+  INSTALL_GENERATIONS_KEPT generations are kept; objects no generation
+  refers to are removed.
+  
+  A hard link shares its bytes with the installed file, so damage to
+  the plugin in place damages the object too. Objects are therefore
+  hashed again before they are used: a bad one is replaced when the
+  file is recorded again, and refused when a version is rebuilt.
+  
+  Layout:
+    objects/<first 2 hex digits>/<sha256>
+    generations/<id>.xml    id = start of the hash of the file list
+    active.txt              id of the installed generation
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "FileClone.h"
+#include "FileSwap.h"
+#include "Sha256.h"
+
+#if !JUCE_WINDOWS
+ #include <sys/stat.h>
+#endif
+
+class InstallStore
+{
+public:
+    struct Generation
+    {
+        juce::String id;                // Empty if invalid
+        juce::String version;           // Empty if installed before the store knew it
+        juce::Time recorded;
+        int numFiles = 0;
+        juce::int64 totalBytes = 0;
+        
+        bool isValid() const { return id.isNotEmpty(); }
+    };
+    
+    /**
+     * Record the installed plugin as a generation and make it the active
+     * one, then prune. Installing the same content again only refreshes
+     * its entry. Returns the generation id, or empty on failure.
+     */
+    static juce::String recordInstalled(const juce::File& plugin, const juce::String& version)
+    {
+        auto startMs = juce::Time::getMillisecondCounterHiRes();
+        auto id = record(plugin, version);
+        
+        if (id.isEmpty())
+            return {};
+        
+        setActiveId(id);
+        prune(UpdaterConfig::INSTALL_GENERATIONS_KEPT);
+        
+        UpdaterConfig::logMessage("Recorded install generation " + id + " in " +
+                                juce::String(juce::roundToInt(juce::Time::getMillisecondCounterHiRes() - startMs)) + " ms");
+        return id;
+    }
+    
+    /**
+     * Record the installed plugin (with no version) unless it is the
+     * active generation, so the version an update replaces can be
+     * switched back to. Compares file sizes only; nothing is hashed when
+     * the install is unchanged.
+     */
+    static void recordIfUnknown(const juce::File& plugin)
+    {
+        if (!plugin.exists() || matchesActive(plugin))
+            return;
+        
+        UpdaterConfig::logMessage("Recording installed version before replacing it");
+        
+        // Not pruned here: that could drop the generation about to be switched to
+        auto id = record(plugin, {});
+        
+        if (id.isNotEmpty())
+            setActiveId(id);
+    }
+    
+    /**
+     * Retained generations, most recently recorded first
+     */
+    static juce::Array<Generation> getGenerations()
+    {
+        juce::Array<Generation> generations;
+        
+        for (auto& file : getGenerationsDir().findChildFiles(juce::File::findFiles, false, "*.xml"))
+        {
+            auto xml = juce::parseXML(file);
+            
+            if (xml == nullptr || !xml->hasTagName("Generation"))
+                continue;
+            
+            Generation generation;
+            generation.id = xml->getStringAttribute("id");
+            generation.version = xml->getStringAttribute("version");
+            generation.recorded = juce::Time(xml->getStringAttribute("recorded").getLargeIntValue());
+            
+            for (auto* e : xml->getChildWithTagNameIterator("File"))
+            {
+                ++generation.numFiles;
+                generation.totalBytes += e->getStringAttribute("size").getLargeIntValue();
+            }
+            
+            if (generation.isValid())
+                generations.add(generation);
+        }
+        
+        std::sort(generations.begin(), generations.end(), [](const Generation& a, const Generation& b)
+        {
+            return a.recorded > b.recorded;
+        });
+        
+        return generations;
+    }
+    
+    static juce::String getActiveId()
+    {
+        return getStoreDir().getChildFile("active.txt").loadFileAsString().trim();
+    }
+    
+    static void setActiveId(const juce::String& id)
+    {
+        getStoreDir().getChildFile("active.txt").replaceWithText(id);
+    }
+    
+    /**
+     * Build generation id at target, which must not exist. Put it on the
+     * plugin's volume so the files are links, then rename it into place.
+     */
+    static bool materialise(const juce::String& id, const juce::File& target)
+    {
+        auto xml = juce::parseXML(getManifestFile(id));
+        
+        if (xml == nullptr || !xml->hasTagName("Generation"))
+        {
+            UpdaterConfig::logMessage("ERROR: Unknown install generation " + id);
+            return false;
+        }
+        
+        auto used = FileClone::Method::reflink;
+        bool ok = true;
+        
+        if (xml->getBoolAttribute("bundle"))
+        {
+            ok = target.createDirectory().wasOk();
+            
+            for (auto* e : xml->getChildWithTagNameIterator("Dir"))
+                ok = ok && target.getChildFile(e->getStringAttribute("path")).createDirectory().wasOk();
+        }
+        
+        for (auto* e : xml->getChildWithTagNameIterator("File"))
+        {
+            auto path = e->getStringAttribute("path");
+            
+            ok = ok && placeObject(e->getStringAttribute("sha256"),
+                                   e->getStringAttribute("size").getLargeIntValue(),
+                                   e->getBoolAttribute("exec"),
+                                   path.isEmpty() ? target : target.getChildFile(path), used);
+        }
+        
+        if (!ok)
+        {
+            UpdaterConfig::logMessage("ERROR: Failed to rebuild install generation " + id);
+            target.deleteRecursively();
+            return false;
+        }
+        
+        UpdaterConfig::logMessage("Rebuilt install generation " + id + " (" + FileClone::getName(used) + ")");
+        return true;
+    }
+    
+    /**
+     * Drop all but the newest keep generations (the active one always
+     * stays), then every object none of the remaining ones uses
+     */
+    static void prune(int keep)
+    {
+        auto active = getActiveId();
+        int kept = 0;
+        
+        for (auto& generation : getGenerations())
+        {
+            if (kept++ < keep || generation.id == active)
+                continue;
+            
+            getManifestFile(generation.id).deleteFile();
+            UpdaterConfig::logMessage("Dropped install generation " + generation.id + " " + generation.version);
+        }
+        
+        juce::StringArray referenced;
+        
+        for (auto& file : getGenerationsDir().findChildFiles(juce::File::findFiles, false, "*.xml"))
+        {
+            auto xml = juce::parseXML(file);
+            
+            // An unreadable manifest might still need its objects
+            if (xml == nullptr)
+                return;
+            
+            for (auto* e : xml->getChildWithTagNameIterator("File"))
+                referenced.add(e->getStringAttribute("sha256"));
+        }
+        
+        for (auto& object : getObjectsDir().findChildFiles(juce::File::findFiles, true, "*"))
+        {
+            if (referenced.indexOf(object.getFileName()) < 0)
+                object.deleteFile();
+        }
+    }
+
+private:
+    struct FileRecord
+    {
+        juce::String path;              // Relative to the bundle root, '/' separated; empty for a single file
+        juce::String sha256;
+        juce::int64 size = 0;
+        bool executable = false;
+    };
+    
+    //==========================================================================
+    // LOCATIONS
+    //==========================================================================
+    
+    static juce::File getStoreDir()         { return UpdaterConfig::getInstallStoreDir(); }
+    static juce::File getObjectsDir()       { return getStoreDir().getChildFile("objects"); }
+    static juce::File getGenerationsDir()   { return getStoreDir().getChildFile("generations"); }
+    
+    static juce::File getManifestFile(const juce::String& id)
+    {
+        return getGenerationsDir().getChildFile(id + ".xml");
+    }
+    
+    static juce::File getObjectFile(const juce::String& sha256)
+    {
+        return getObjectsDir().getChildFile(sha256.substring(0, 2)).getChildFile(sha256);
+    }
+    
+    //==========================================================================
+    // RECORDING
+    //==========================================================================
+    
+    static juce::String record(const juce::File& plugin, const juce::String& version)
+    {
+        if (getStoreDir() == juce::File() || !plugin.exists())
+            return {};
+        
+        bool isBundle = plugin.isDirectory();
+        juce::StringArray dirs;
+        juce::Array<FileRecord> files;
+        
+        if (isBundle)
+        {
+            for (auto& dir : plugin.findChildFiles(juce::File::findDirectories, true, "*",
+                                                   juce::File::FollowSymlinks::no))
+                dirs.add(getRelativePath(dir, plugin));
+            
+            for (auto& file : plugin.findChildFiles(juce::File::findFiles, true, "*",
+                                                    juce::File::FollowSymlinks::no))
+            {
+                FileRecord r;
+                r.path = getRelativePath(file, plugin);
+                files.add(r);
+            }
+        }
+        else
+        {
+            files.add(FileRecord());
+        }
+        
+        dirs.sort(false);
+        std::sort(files.begin(), files.end(), [](const FileRecord& a, const FileRecord& b)
+        {
+            return a.path < b.path;
+        });
+        
+        // The id hashes the listing, so identical installs share one generation
+        Sha256 listingHash;
+        
+        for (auto& r : files)
+        {
+            auto file = r.path.isEmpty() ? plugin : plugin.getChildFile(r.path);
+            
+            r.sha256 = Sha256::hashFile(file);
+            r.size = file.getSize();
+            r.executable = isExecutable(file);
+            
+            if (r.sha256.isEmpty() || !addObject(file, r.sha256))
+            {
+                UpdaterConfig::logMessage("ERROR: Failed to store " + file.getFullPathName());
+                return {};
+            }
+            
+            auto line = r.path + "\t" + r.sha256 + "\t" + (r.executable ? "x" : "-") + "\n";
+            listingHash.update(line.toRawUTF8(), line.getNumBytesAsUTF8());
+        }
+        
+        for (auto& dir : dirs)
+        {
+            auto line = dir + "/\n";
+            listingHash.update(line.toRawUTF8(), line.getNumBytesAsUTF8());
+        }
+        
+        auto id = listingHash.finish().substring(0, 16);
+        
+        juce::XmlElement xml("Generation");
+        xml.setAttribute("id", id);
+        xml.setAttribute("version", version.isNotEmpty() ? version : getRecordedVersion(id));
+        xml.setAttribute("recorded", juce::String(juce::Time::currentTimeMillis()));
+        xml.setAttribute("bundle", isBundle);
+        
+        for (auto& dir : dirs)
+            xml.createNewChildElement("Dir")->setAttribute("path", dir);
+        
+        for (auto& r : files)
+        {
+            auto* e = xml.createNewChildElement("File");
+            e->setAttribute("path", r.path);
+            e->setAttribute("sha256", r.sha256);
+            e->setAttribute("size", juce::String(r.size));
+            e->setAttribute("exec", r.executable);
+        }
+        
+        auto manifest = getManifestFile(id);
+        manifest.getParentDirectory().createDirectory();
+        juce::TemporaryFile temp(manifest);
+        
+        if (!xml.writeTo(temp.getFile()) || !temp.overwriteTargetFileWithTemporary())
+            return {};
+        
+        return id;
+    }
+    
+    /**
+     * Link (or clone) file, whose hash is sha256, into the store under
+     * that hash, unless a good object with that hash is already there.
+     * Staged under a temporary name, so a crash never leaves a partial
+     * object.
+     */
+    static bool addObject(const juce::File& file, const juce::String& sha256)
+    {
+        auto object = getObjectFile(sha256);
+        
+        if (object.existsAsFile())
+        {
+            // The file's own inode was just hashed; anything else is read again
+            if (object.getFileIdentifier() == file.getFileIdentifier() || Sha256::hashFile(object) == sha256)
+                return true;
+            
+            UpdaterConfig::logMessage("WARNING: Damaged install store object replaced: " + sha256);
+        }
+        
+        object.getParentDirectory().createDirectory();
+        auto temp = object.getSiblingFile(sha256 + ".tmp");
+        temp.deleteFile();
+        
+        if (FileClone::cloneItem(file, temp, true) && FileSwap::rename(temp, object))
+            return true;
+        
+        temp.deleteFile();
+        return false;
+    }
+    
+    static bool placeObject(const juce::String& sha256, juce::int64 size, bool executable,
+                            const juce::File& target, FileClone::Method& used)
+    {
+        auto object = getObjectFile(sha256);
+        
+        if (!object.existsAsFile() || object.getSize() != size)
+        {
+            UpdaterConfig::logMessage("ERROR: Install store object missing: " + sha256);
+            return false;
+        }
+        
+        // Never rebuild a version from damaged bytes
+        if (Sha256::hashFile(object) != sha256)
+        {
+            UpdaterConfig::logMessage("ERROR: Install store object damaged: " + sha256);
+            object.deleteFile();
+            return false;
+        }
+        
+        auto method = FileClone::Method::copy;
+        
+        if (!FileClone::cloneItem(object, target, true, &method))
+            return false;
+        
+        used = juce::jmax(used, method);
+        
+        if (executable)
+            target.setExecutePermission(true);
+        
+        return true;
+    }
+    
+    /**
+     * True if plugin has the active generation's files, by size
+     */
+    static bool matchesActive(const juce::File& plugin)
+    {
+        auto active = getActiveId();
+        auto xml = active.isNotEmpty() ? juce::parseXML(getManifestFile(active)) : nullptr;
+        
+        if (xml == nullptr || xml->getBoolAttribute("bundle") != plugin.isDirectory())
+            return false;
+        
+        int numFiles = 0;
+        
+        for (auto* e : xml->getChildWithTagNameIterator("File"))
+        {
+            auto path = e->getStringAttribute("path");
+            auto file = path.isEmpty() ? plugin : plugin.getChildFile(path);
+            
+            if (!file.existsAsFile() || file.getSize() != e->getStringAttribute("size").getLargeIntValue())
+                return false;
+            
+            ++numFiles;
+        }
+        
+        auto installedFiles = plugin.isDirectory()
+            ? plugin.findChildFiles(juce::File::findFiles, true, "*", juce::File::FollowSymlinks::no).size()
+            : 1;
+        
+        return installedFiles == numFiles;
+    }
+    
+    static juce::String getRecordedVersion(const juce::String& id)
+    {
+        auto xml = juce::parseXML(getManifestFile(id));
+        return xml != nullptr ? xml->getStringAttribute("version") : juce::String();
+    }
+    
+    //==========================================================================
+    // HELPERS
+    //==========================================================================
+    
+    static juce::String getRelativePath(const juce::File& file, const juce::File& root)
+    {
+        return file.getRelativePathFrom(root).replaceCharacter('\\', '/');
+    }
+    
+    static bool isExecutable(const juce::File& file)
+    {
+        #if JUCE_WINDOWS
+            juce::ignoreUnused(file);
+            return false;
+        #else
+            struct stat info {};
+            return stat(file.getFullPathName().toRawUTF8(), &info) == 0 && (info.st_mode & 0111) != 0;
+        #endif
+    }
+};
\ No newline at end of file
@@ -0,0 +1,598 @@
+/*
+  InstallVerifier.h - Check installed files against the release's hashes
+  
+  A release may publish "<asset>.files.sha256" next to the asset: one
+  line per plugin file in sha256sum format, paths relative to the
+  bundle root ("<hex>  Contents/x86_64-win/samp.vst3"; a single-file
+  plugin is listed under its own name).
+  
+  After an install the manifest is kept with the plugin's record. Every
+  installed file is then hashed in parallel, largest first, and checked
+  against it. Files that don't match are fetched again on their own:
+  - From a zip asset, the directory is read from the last bytes of the
+    asset, and each bad entry is fetched with a Range request, decoded
+    and checked before it replaces the installed file.
+  - Other formats can't be read in pieces. The asset is downloaded
+    again, and only the bad files are taken from it.
+  
+  The size and modification time of each file that matched are stored.
+  A quick check (every launch) only hashes files whose size or time
+  changed since then.
+  
+  The InstallStore's objects are hard links of the installed files, so
+  they were damaged along with them. After a repair the plugin is
+  recorded again, which replaces the damaged objects.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "ArchiveExtractor.h"
+#include "CopyEngine.h"
+#include "FileSwap.h"
+#include "GitHubAPI.h"
+#include "InstallStore.h"
+#include "NetworkEngine.h"
+#include "ReleaseInfo.h"
+#include "ResourceGovernor.h"
+#include "Sha256.h"
+#include "ZipArchive.h"
+
+#if !JUCE_WINDOWS
+ #include <unistd.h>
+#endif
+
+class InstallVerifier
+{
+public:
+    struct Report
+    {
+        bool hasManifest = false;       // False: nothing to check against
+        int numFiles = 0;               // Listed in the manifest
+        int numHashed = 0;              // The others were unchanged since they last matched
+        juce::StringArray bad;          // Missing or different (manifest paths)
+        
+        bool isOk() const { return hasManifest && bad.isEmpty(); }
+    };
+    
+    //==========================================================================
+    // MANIFEST
+    //==========================================================================
+    
+    static bool isFileManifestAsset(const juce::String& name)
+    {
+        return name.endsWithIgnoreCase(".files.sha256");
+    }
+    
+    /**
+     * Fetch the per-file manifest published for the release's asset.
+     * Returns empty if there is none (or its digest doesn't match).
+     */
+    static juce::String fetchManifest(const ReleaseInfo& release)
+    {
+        auto assetName = juce::URL::removeEscapeChars(release.downloadUrl.fromLastOccurrenceOf("/", false, false));
+        
+        for (auto& asset : release.assets)
+        {
+            if (!isFileManifestAsset(asset.name) || !asset.name.dropLastCharacters(13).equalsIgnoreCase(assetName))
+                continue;
+            
+            int statusCode = 0;
+            
+            auto stream = juce::URL(asset.downloadUrl).createInputStream(
+                juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                    .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                    .withStatusCode(&statusCode)
+            );
+            
+            if (stream == nullptr || statusCode != 200)
+            {
+                UpdaterConfig::logMessage("WARNING: Failed to fetch file manifest, status " + juce::String(statusCode));
+                return {};
+            }
+            
+            juce::MemoryBlock data;
+            stream->readIntoMemoryBlock(data);
+            
+            auto expected = GitHubAPI::parseSha256(asset.digest);
+            
+            if (expected.isNotEmpty())
+            {
+                Sha256 hasher;
+                hasher.update(data.getData(), data.getSize());
+                
+                if (hasher.finish() != expected)
+                {
+                    UpdaterConfig::logMessage("ERROR: File manifest digest mismatch");
+                    return {};
+                }
+            }
+            
+            return data.toString();
+        }
+        
+        return {};
+    }
+    
+    /**
+     * Remember what was just installed and the hashes it must have.
+     * Without a manifest the old record is dropped, since it no longer
+     * describes the install.
+     */
+    static bool recordInstall(const ReleaseInfo& release, const juce::String& manifest)
+    {
+        auto recordFile = UpdaterConfig::getInstalledFilesFile();
+        
+        juce::XmlElement xml("InstalledFiles");
+        xml.setAttribute("version", release.version);
+        xml.setAttribute("assetUrl", release.downloadUrl);
+        xml.setAttribute("assetSha256", release.sha256);
+        xml.setAttribute("assetSize", juce::String(release.fileSize));
+        
+        for (auto line : juce::StringArray::fromLines(manifest))
+        {
+            line = line.trim();
+            
+            if (line.isEmpty() || line.startsWithChar('#'))
+                continue;
+            
+            auto sha256 = GitHubAPI::parseSha256(line.upToFirstOccurrenceOf(" ", false, false));
+            auto path = normalisePath(line.fromFirstOccurrenceOf(" ", false, false).trimStart());
+            
+            // Empty is the plugin itself
+            if (sha256.isEmpty() || (path.isNotEmpty() && !ArchiveExtractor::isSafePath(path)))
+            {
+                UpdaterConfig::logMessage("WARNING: Ignoring bad file manifest line: " + line);
+                continue;
+            }
+            
+            auto* e = xml.createNewChildElement("File");
+            e->setAttribute("path", path);
+            e->setAttribute("sha256", sha256);
+        }
+        
+        if (xml.getNumChildElements() == 0)
+        {
+            UpdaterConfig::logMessage("No file manifest for this release, installed files can't be verified");
+            clearRecord();
+            return false;
+        }
+        
+        return save(xml, recordFile);
+    }
+    
+    /**
+     * Forget the record (the installed files came from somewhere else)
+     */
+    static void clearRecord()
+    {
+        UpdaterConfig::getInstalledFilesFile().deleteFile();
+    }
+    
+    //==========================================================================
+    // VERIFICATION
+    //==========================================================================
+    
+    /**
+     * Hash the installed files on every core and compare them with the
+     * record. quick: skip files unchanged since they last matched.
+     */
+    static Report verify(bool quick)
+    {
+        Report report;
+        auto recordFile = UpdaterConfig::getInstalledFilesFile();
+        auto xml = juce::parseXML(recordFile);
+        
+        if (xml == nullptr || !xml->hasTagName("InstalledFiles"))
+            return report;
+        
+        auto plugin = UpdaterConfig::getPluginInstallPath();
+        auto startMs = juce::Time::getMillisecondCounterHiRes();
+        
+        juce::Array<juce::XmlElement*> toHash;
+        juce::StringArray hashes;
+        juce::int64 totalBytes = 0;
+        
+        report.hasManifest = true;
+        
+        for (auto* e : xml->getChildWithTagNameIterator("File"))
+        {
+            ++report.numFiles;
+            auto file = resolve(plugin, e->getStringAttribute("path"));
+            
+            if (quick && isUnchanged(*e, file))
+                continue;
+            
+            toHash.add(e);
+            hashes.add({});
+            totalBytes += juce::jmax<juce::int64>(0, file.getSize());
+        }
+        
+        // Largest first, so a big binary doesn't start last
+        std::sort(toHash.begin(), toHash.end(), [&](juce::XmlElement* a, juce::XmlElement* b)
+        {
+            return resolve(plugin, a->getStringAttribute("path")).getSize()
+                 > resolve(plugin, b->getStringAttribute("path")).getSize();
+        });
+        
+        auto threads = ResourceGovernor::getThreadCount(UpdaterConfig::VERIFY_THREADS, toHash.size());
+        
+        CopyEngine::forEach(toHash.size(), [&](int i)
+        {
+            hashes.getReference(i) = Sha256::hashFile(resolve(plugin, toHash[i]->getStringAttribute("path")));
+        }, threads);
+        
+        for (int i = 0; i < toHash.size(); ++i)
+        {
+            auto* e = toHash[i];
+            auto file = resolve(plugin, e->getStringAttribute("path"));
+            
+            if (hashes[i].isNotEmpty() && hashes[i] == e->getStringAttribute("sha256"))
+            {
+                e->setAttribute("size", juce::String(file.getSize()));
+                e->setAttribute("modified", juce::String(file.getLastModificationTime().toMilliseconds()));
+            }
+            else
+            {
+                e->removeAttribute("size");
+                e->removeAttribute("modified");
+                report.bad.add(e->getStringAttribute("path"));
+            }
+        }
+        
+        report.numHashed = toHash.size();
+        save(*xml, recordFile);
+        
+        UpdaterConfig::logMessage("Verified " + juce::String(report.numFiles) + " installed files (" +
+                                juce::String(report.numHashed) + " hashed, " + juce::String(totalBytes) + " bytes) in " +
+                                juce::String(juce::roundToInt(juce::Time::getMillisecondCounterHiRes() - startMs)) +
+                                " ms on " + juce::String(threads) + " thread(s): " +
+                                (report.bad.isEmpty() ? juce::String("all match")
+                                                      : juce::String(report.bad.size()) + " bad"));
+        
+        for (auto& path : report.bad)
+            UpdaterConfig::logMessage("  Bad: " + (path.isEmpty() ? plugin.getFileName() : path));
+        
+        return report;
+    }
+    
+    //==========================================================================
+    // REPAIR
+    //==========================================================================
+    
+    /**
+     * Fetch the bad files again and put them in place; each is checked
+     * against the manifest before it replaces the installed one, and the
+     * store re-records the plugin. Network thread only. Returns true if
+     * every file was replaced.
+     */
+    static bool repair(const juce::StringArray& bad)
+    {
+        auto xml = juce::parseXML(UpdaterConfig::getInstalledFilesFile());
+        
+        if (xml == nullptr || bad.isEmpty())
+            return false;
+        
+        auto url = xml->getStringAttribute("assetUrl");
+        auto assetName = juce::URL::removeEscapeChars(url.fromLastOccurrenceOf("/", false, false));
+        
+        juce::StringPairArray expected(false);
+        
+        for (auto* e : xml->getChildWithTagNameIterator("File"))
+            expected.set(e->getStringAttribute("path"), e->getStringAttribute("sha256"));
+        
+        UpdaterConfig::logMessage("Re-fetching " + juce::String(bad.size()) + " bad file(s) from " + assetName);
+        
+        bool repaired = ArchiveExtractor::getFormat(assetName) == ArchiveExtractor::Format::zip
+                        && repairFromZip(url, bad, expected);
+        
+        if (!repaired && !NetworkEngine::shouldCurrentJobStop())
+            repaired = repairFromDownload(*xml, bad, expected);
+        
+        // Its objects still hold the damaged bytes
+        if (repaired)
+            InstallStore::recordInstalled(UpdaterConfig::getPluginInstallPath(), xml->getStringAttribute("version"));
+        
+        return repaired;
+    }
+
+private:
+    static constexpr int chunkSize = 64 * 1024;
+    
+    // End of central directory (with a full comment) plus the zip64 locator and record
+    static constexpr int zipTailBytes = 22 + 65535 + 20 + 56;
+    
+    //==========================================================================
+    // RANGED ZIP ENTRIES
+    //==========================================================================
+    
+    static bool repairFromZip(const juce::String& url, const juce::StringArray& bad,
+                              const juce::StringPairArray& expected)
+    {
+        juce::int64 fileSize = -1;
+        juce::MemoryBlock tail;
+        
+        if (!fetchRange(url, "-" + juce::String(zipTailBytes), tail, &fileSize))
+            return false;
+        
+        auto zip = std::make_unique<ZipArchive>(tail, fileSize);
+        
+        // A big directory starts before the tail: fetch from its start
+        if (!zip->isValid() && zip->getDirectoryOffset() >= 0
+            && zip->getDirectoryOffset() < fileSize - (juce::int64) tail.getSize())
+        {
+            if (!fetchRange(url, juce::String(zip->getDirectoryOffset()) + "-", tail, &fileSize))
+                return false;
+            
+            zip = std::make_unique<ZipArchive>(tail, fileSize);
+        }
+        
+        if (!zip->isValid())
+            return false;
+        
+        auto root = ArchiveExtractor::findBundleRoot(zip->getEntries());
+        auto plugin = UpdaterConfig::getPluginInstallPath();
+        
+        for (auto& path : bad)
+        {
+            auto entryPath = path.isEmpty() ? root : root + "/" + path;
+            const ZipArchive::Entry* entry = nullptr;
+            
+            for (auto& e : zip->getEntries())
+                if (e.path == entryPath)
+                    entry = &e;
+            
+            if (entry == nullptr || !repairEntry(url, *entry, resolve(plugin, path), expected[path]))
+            {
+                UpdaterConfig::logMessage("ERROR: Could not re-fetch " + entryPath);
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    static bool repairEntry(const juce::String& url, const ZipArchive::Entry& entry,
+                            const juce::File& target, const juce::String& expectedSha256)
+    {
+        if (entry.isEncrypted || (entry.method != 0 && entry.method != 8))
+            return false;
+        
+        // The local header's name and extra field may differ in length from the central record
+        juce::MemoryBlock header;
+        
+        if (!fetchRange(url, juce::String(entry.headerOffset) + "-" + juce::String(entry.headerOffset + 29), header)
+            || header.getSize() != 30
+            || juce::ByteOrder::littleEndianInt(header.getData()) != 0x04034b50)
+            return false;
+        
+        auto* h = static_cast<const juce::uint8*>(header.getData());
+        auto dataStart = entry.headerOffset + 30 + juce::ByteOrder::littleEndianShort(h + 26)
+                       + juce::ByteOrder::littleEndianShort(h + 28);
+        
+        std::unique_ptr<juce::InputStream> compressed;
+        
+        if (entry.compressedSize > 0)
+        {
+            compressed = openRange(url, juce::String(dataStart) + "-" + juce::String(dataStart + entry.compressedSize - 1));
+            
+            if (compressed == nullptr)
+                return false;
+        }
+        else
+        {
+            compressed = std::make_unique<juce::MemoryInputStream>(nullptr, 0, false);
+        }
+        
+        juce::OptionalScopedPointer<juce::InputStream> decoded(compressed.get(), false);
+        
+        if (entry.method == 8)
+            decoded.set(new juce::GZIPDecompressorInputStream(compressed.get(), false,
+                                                              juce::GZIPDecompressorInputStream::deflateFormat), true);
+        
+        // Checked against the manifest's SHA-256, which supersedes the entry's CRC
+        if (!replaceFrom(*decoded, entry.size, target, expectedSha256))
+            return false;
+        
+        if ((entry.mode & 0111) != 0)
+            target.setExecutePermission(true);
+        
+        return true;
+    }
+    
+    //==========================================================================
+    // FULL DOWNLOAD
+    //==========================================================================
+    
+    static bool repairFromDownload(const juce::XmlElement& record, const juce::StringArray& bad,
+                                   const juce::StringPairArray& expected)
+    {
+        auto url = record.getStringAttribute("assetUrl");
+        auto repairDir = UpdaterConfig::getTempDownloadDir().getChildFile("repair");
+        auto download = repairDir.getChildFile(juce::URL::removeEscapeChars(url.fromLastOccurrenceOf("/", false, false)));
+        auto size = record.getStringAttribute("assetSize", "-1").getLargeIntValue();
+        
+        repairDir.deleteRecursively();
+        repairDir.createDirectory();
+        
+        auto source = GitHubAPI::downloadFile(url, download, nullptr, record.getStringAttribute("assetSha256"),
+                                              size > 0 ? size : -1)
+                    ? ArchiveExtractor::extract(download, repairDir.getChildFile("unpacked"))
+                    : juce::File();
+        
+        bool ok = source.exists();
+        auto plugin = UpdaterConfig::getPluginInstallPath();
+        
+        for (auto& path : bad)
+        {
+            if (!ok)
+                break;
+            
+            juce::FileInputStream in(resolve(source, path));
+            
+            ok = in.openedOk() && replaceFrom(in, in.getTotalLength(), resolve(plugin, path), expected[path]);
+            
+            if (ok && isExecutableFile(resolve(source, path)))
+                resolve(plugin, path).setExecutePermission(true);
+        }
+        
+        repairDir.deleteRecursively();
+        return ok;
+    }
+    
+    //==========================================================================
+    // HELPERS
+    //==========================================================================
+    
+    /**
+     * Write size bytes of in next to target, check them against
+     * expectedSha256, then rename them over target
+     */
+    static bool replaceFrom(juce::InputStream& in, juce::int64 size, const juce::File& target,
+                            const juce::String& expectedSha256)
+    {
+        auto temp = target.getSiblingFile(target.getFileName() + ".repair");
+        Sha256 hasher;
+        bool ok = false;
+        
+        target.getParentDirectory().createDirectory();
+        temp.deleteFile();
+        
+        {
+            juce::FileOutputStream out(temp);
+            juce::HeapBlock<char> buffer(chunkSize);
+            juce::int64 written = 0;
+            
+            while (!out.failedToOpen() && written < size)
+            {
+                if (NetworkEngine::shouldCurrentJobStop())
+                    break;
+                
+                auto n = in.read(buffer.getData(), (int) juce::jmin<juce::int64>(chunkSize, size - written));
+                
+                if (n <= 0 || !out.write(buffer.getData(), (size_t) n))
+                    break;
+                
+                ResourceGovernor::throttle(n);
+                hasher.update(buffer.getData(), (size_t) n);
+                written += n;
+            }
+            
+            out.flush();
+            ok = written == size && out.getStatus().wasOk();
+        }
+        
+        if (ok && hasher.finish() != expectedSha256)
+        {
+            UpdaterConfig::logMessage("ERROR: Re-fetched " + target.getFileName() + " doesn't match the manifest");
+            ok = false;
+        }
+        
+        ok = ok && FileSwap::rename(temp, target);
+        
+        if (!ok)
+            temp.deleteFile();
+        else
+            UpdaterConfig::logMessage("Repaired " + target.getFullPathName());
+        
+        return ok;
+    }
+    
+    static std::unique_ptr<juce::InputStream> openRange(const juce::String& url, const juce::String& range,
+                                                        juce::int64* fileSize = nullptr)
+    {
+        int statusCode = 0;
+        juce::StringPairArray headers;
+        
+        auto stream = juce::URL(url).createInputStream(
+            juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                .withExtraHeaders("Range: bytes=" + range + "\r\n")
+                .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                .withResponseHeaders(&headers)
+                .withStatusCode(&statusCode)
+        );
+        
+        if (stream == nullptr || statusCode != 206)
+        {
+            UpdaterConfig::logMessage("ERROR: Range request failed, status " + juce::String(statusCode));
+            return nullptr;
+        }
+        
+        // "Content-Range: bytes <first>-<last>/<total>"
+        if (fileSize != nullptr)
+            *fileSize = headers["Content-Range"].fromLastOccurrenceOf("/", false, false).getLargeIntValue();
+        
+        return stream;
+    }
+    
+    static bool fetchRange(const juce::String& url, const juce::String& range, juce::MemoryBlock& data,
+                           juce::int64* fileSize = nullptr)
+    {
+        auto stream = openRange(url, range, fileSize);
+        
+        if (stream == nullptr || (fileSize != nullptr && *fileSize <= 0))
+            return false;
+        
+        data.reset();
+        stream->readIntoMemoryBlock(data);
+        ResourceGovernor::throttle((int) data.getSize());
+        return data.getSize() > 0;
+    }
+    
+    static bool isUnchanged(const juce::XmlElement& e, const juce::File& file)
+    {
+        return e.hasAttribute("size") && file.existsAsFile()
+            && e.getStringAttribute("size").getLargeIntValue() == file.getSize()
+            && e.getStringAttribute("modified").getLargeIntValue() == file.getLastModificationTime().toMilliseconds();
+    }
+    
+    /**
+     * Manifest path -> file; empty is the plugin itself
+     */
+    static juce::File resolve(const juce::File& plugin, const juce::String& path)
+    {
+        return path.isEmpty() ? plugin : plugin.getChildFile(path);
+    }
+    
+    /**
+     * '/' separated, relative to the bundle root ("" for the plugin
+     * itself, when it is a single file)
+     */
+    static juce::String normalisePath(juce::String path)
+    {
+        // sha256sum marks binary mode with '*'
+        if (path.startsWithChar('*'))
+            path = path.substring(1);
+        
+        path = path.replaceCharacter('\\', '/');
+        
+        if (path.startsWith("./"))
+            path = path.substring(2);
+        
+        auto name = juce::String(UpdaterConfig::PLUGIN_NAME);
+        
+        if (path == name)
+            return {};
+        
+        return path.startsWith(name + "/") ? path.substring(name.length() + 1) : path;
+    }
+    
+    static bool isExecutableFile(const juce::File& file)
+    {
+        #if JUCE_WINDOWS
+            juce::ignoreUnused(file);
+            return false;
+        #else
+            return access(file.getFullPathName().toRawUTF8(), X_OK) == 0;
+        #endif
+    }
+    
+    static bool save(const juce::XmlElement& xml, const juce::File& file)
+    {
+        file.getParentDirectory().createDirectory();
+        juce::TemporaryFile temp(file);
+        
+        return xml.writeTo(temp.getFile())
+            && temp.overwriteTargetFileWithTemporary();
+    }
+};
\ No newline at end of file
@@ -0,0 +1,232 @@
+/*
+  MirrorSelector.h - Pick the fastest source for a release asset
+  
+  Races a HEAD probe against every source happy-eyeballs style: the
+  preferred source starts first, each further one MIRROR_STAGGER_MS
+  later unless a winner has already answered. Sources that answer are
+  ranked by latency; ones that never got (or finished) a probe follow
+  in configured order, so Downloader can fail over to them later.
+  
+  Probes run on NetworkEngine's transfer pool. Once the race is decided
+  the ones still connecting are cancelled, and rank() only returns when
+  every probe has stopped.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <memory>
+#include "../Config.h"
+#include "NetworkEngine.h"
+
+class MirrorSelector
+{
+public:
+    struct Source
+    {
+        juce::String url;
+        double latencyMs = -1.0;        // -1 if not measured
+        juce::int64 contentLength = -1; // -1 if unknown
+    };
+    
+    /**
+     * Rank sources for one asset, fastest first. Sources that answered
+     * with a different size than expectedSize (when >= 0), or with an
+     * error, are dropped. Never returns an empty list for non-empty input:
+     * if nothing answers, the configured order is kept.
+     */
+    static juce::Array<Source> rank(const juce::StringArray& urls, juce::int64 expectedSize = -1)
+    {
+        juce::Array<Source> ranked;
+        
+        if (urls.size() <= 1)
+        {
+            for (auto& url : urls)
+                ranked.add({ url });
+            
+            return ranked;
+        }
+        
+        auto& pool = NetworkEngine::getInstance().getTransferPool();
+        auto race = std::make_shared<Race>();
+        auto startMs = juce::Time::getMillisecondCounter();
+        auto timeoutMs = UpdaterConfig::MIRROR_PROBE_TIMEOUT_MS + urls.size() * UpdaterConfig::MIRROR_STAGGER_MS;
+        race->pending = urls.size();
+        
+        for (int i = 0; i < urls.size(); ++i)
+        {
+            // Later sources only start if nobody has answered yet
+            if (i > 0 && (race->winnerFound.wait(UpdaterConfig::MIRROR_STAGGER_MS)
+                          || NetworkEngine::shouldCurrentJobStop()))
+                break;
+            
+            auto url = urls[i];
+            race->started();
+            
+            pool.addJob([race, url, expectedSize]
+            {
+                race->finish(probe(*race, url, expectedSize));
+                race->stopped();
+            });
+        }
+        
+        // Until the first answer, every probe has failed, or time is up
+        while (!race->winnerFound.wait(50))
+        {
+            if (NetworkEngine::shouldCurrentJobStop()
+                || (int) (juce::Time::getMillisecondCounter() - startMs) >= timeoutMs)
+                break;
+        }
+        
+        // Whatever is still connecting has lost
+        race->cancelAll();
+        race->allStopped.wait(-1);
+        
+        const juce::ScopedLock lock(race->lock);
+        ranked = race->answered;
+        
+        for (auto& url : urls)
+        {
+            bool known = false;
+            
+            for (auto& s : ranked)
+                known = known || s.url == url;
+            
+            if (!known && !race->failed.contains(url))
+                ranked.add({ url });
+        }
+        
+        if (ranked.isEmpty())
+            ranked.add({ urls[0] });
+        
+        if (ranked.getFirst().latencyMs >= 0.0)
+            UpdaterConfig::logMessage("Fastest source: " + getHost(ranked.getFirst().url) + " (" +
+                                    juce::String((int) ranked.getFirst().latencyMs) + " ms)");
+        
+        return ranked;
+    }
+    
+    static juce::String getHost(const juce::String& url)
+    {
+        return juce::URL(url).getDomain();
+    }
+
+private:
+    //==========================================================================
+    
+    struct Race
+    {
+        juce::CriticalSection lock;
+        juce::Array<Source> answered;   // In order of arrival
+        juce::StringArray failed;
+        int pending = 0;                // Sources without a result (probed or not)
+        int running = 0;                // Probes on the pool
+        bool cancelled = false;
+        juce::Array<juce::WebInputStream*> connecting;
+        juce::WaitableEvent winnerFound { true };
+        juce::WaitableEvent allStopped { true };
+        
+        void finish(const Source& result)
+        {
+            const juce::ScopedLock sl(lock);
+            
+            if (result.latencyMs >= 0.0)
+                answered.add(result);
+            else if (result.url.isNotEmpty())
+                failed.add(result.url);
+            
+            // First answer wins; or give up once every probe is done
+            if (!answered.isEmpty() || --pending <= 0)
+                winnerFound.signal();
+        }
+        
+        void started()
+        {
+            const juce::ScopedLock sl(lock);
+            ++running;
+        }
+        
+        void stopped()
+        {
+            const juce::ScopedLock sl(lock);
+            
+            if (--running == 0 && cancelled)
+                allStopped.signal();
+        }
+        
+        /**
+         * Register a probe's stream so cancelAll() can reach it.
+         * False if the race is already over.
+         */
+        bool connect(juce::WebInputStream& stream)
+        {
+            const juce::ScopedLock sl(lock);
+            
+            if (cancelled)
+                return false;
+            
+            connecting.add(&stream);
+            return true;
+        }
+        
+        void disconnect(juce::WebInputStream& stream)
+        {
+            const juce::ScopedLock sl(lock);
+            connecting.removeFirstMatchingValue(&stream);
+        }
+        
+        bool isCancelled()
+        {
+            const juce::ScopedLock sl(lock);
+            return cancelled;
+        }
+        
+        void cancelAll()
+        {
+            const juce::ScopedLock sl(lock);
+            cancelled = true;
+            
+            for (auto* stream : connecting)
+                stream->cancel();
+            
+            if (running == 0)
+                allStopped.signal();
+        }
+    };
+    
+    /**
+     * HEAD the source. A probe cut short by cancelAll() returns no URL,
+     * so the source keeps its place as untried rather than failed.
+     */
+    static Source probe(Race& race, const juce::String& url, juce::int64 expectedSize)
+    {
+        Source source;
+        source.url = url;
+        
+        juce::WebInputStream stream(juce::URL(url), false);
+        stream.withCustomRequestCommand("HEAD")
+              .withConnectionTimeout(UpdaterConfig::MIRROR_PROBE_TIMEOUT_MS);
+        
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        
+        if (!race.connect(stream))
+            return {};
+        
+        bool connected = stream.connect(nullptr);
+        race.disconnect(stream);
+        
+        if (!connected || stream.getStatusCode() != 200)
+            return race.isCancelled() ? Source() : source;
+        
+        source.contentLength = stream.getResponseHeaders().getValue("Content-Length", "-1").getLargeIntValue();
+        
+        // Same name but different bytes is no mirror of this asset
+        if (expectedSize >= 0 && source.contentLength >= 0 && source.contentLength != expectedSize)
+        {
+            UpdaterConfig::logMessage("Ignoring source with wrong size: " + getHost(url));
+            return source;
+        }
+        
+        source.latencyMs = juce::Time::getMillisecondCounterHiRes() - start;
+        return source;
+    }
+};
\ No newline at end of file
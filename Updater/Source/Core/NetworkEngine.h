@@ -0,0 +1,347 @@
+/*
+  NetworkEngine.h - Single owner of all updater network work
+  
+  Handles:
+  - One dispatcher thread that runs every API check / download in order
+  - A shared transfer pool for parallel byte-range workers
+  - Futures or message-thread callbacks for submitted work
+  - Caching resolved redirect targets (github.com -> CDN)
+  - Pre-warming DNS/TLS at startup
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <map>
+#include "../Config.h"
+
+class NetworkEngine : private juce::Thread
+{
+public:
+    using Job = std::function<void()>;
+    
+    //==========================================================================
+    // INSTANCE
+    //==========================================================================
+    
+    static NetworkEngine& getInstance()
+    {
+        const juce::SpinLock::ScopedLockType lock(getInstanceLock());
+        auto& instance = getInstancePointer();
+        
+        if (instance == nullptr)
+            instance.reset(new NetworkEngine());
+        
+        return *instance;
+    }
+    
+    /**
+     * Stop dispatcher and transfer pool (call once at app shutdown)
+     */
+    static void shutdown()
+    {
+        std::unique_ptr<NetworkEngine> instance;
+        
+        {
+            const juce::SpinLock::ScopedLockType lock(getInstanceLock());
+            instance = std::move(getInstancePointer());
+        }
+        
+        instance = nullptr;
+    }
+    
+    ~NetworkEngine() override
+    {
+        {
+            const juce::ScopedLock lock(queueLock);
+            queue.clear();
+            currentCancelled = true;
+        }
+        
+        stopThread(10000);
+        transferPool.removeAllJobs(true, 5000);
+        getLiveInstance() = nullptr;
+    }
+    
+    //==========================================================================
+    // SUBMITTING WORK
+    //==========================================================================
+    
+    /**
+     * Queue a job; owner is used to cancel it later (may be nullptr)
+     */
+    void post(const void* owner, Job job)
+    {
+        {
+            const juce::ScopedLock lock(queueLock);
+            queue.push_back({ owner, std::move(job) });
+        }
+        
+        notify();
+    }
+    
+    /**
+     * Queue work and get its result as a future
+     */
+    template <typename Fn>
+    auto submit(const void* owner, Fn work) -> std::future<decltype(work())>
+    {
+        using Result = decltype(work());
+        
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(work));
+        auto future = task->get_future();
+        
+        post(owner, [task] { (*task)(); });
+        return future;
+    }
+    
+    /**
+     * Queue work and deliver its result to a callback on the message thread
+     */
+    template <typename Fn, typename Callback>
+    void submit(const void* owner, Fn work, Callback callback)
+    {
+        post(owner, [work, callback]() mutable
+        {
+            auto result = work();
+            
+            juce::MessageManager::callAsync([callback, result]() mutable
+            {
+                callback(result);
+            });
+        });
+    }
+    
+    /**
+     * Drop queued jobs of owner and wait for its running job to stop.
+     * Running jobs see the request through shouldCurrentJobStop().
+     */
+    void cancelJobsFor(const void* owner)
+    {
+        {
+            const juce::ScopedLock lock(queueLock);
+            
+            queue.erase(std::remove_if(queue.begin(), queue.end(),
+                                       [owner](const Entry& e) { return e.owner == owner; }),
+                        queue.end());
+            
+            if (currentOwner != owner)
+                return;
+            
+            currentCancelled = true;
+        }
+        
+        // A job cancelling itself just sees the flag
+        if (juce::Thread::getCurrentThreadId() == getThreadId())
+            return;
+        
+        for (;;)
+        {
+            {
+                const juce::ScopedLock lock(queueLock);
+                
+                if (currentOwner != owner)
+                    return;
+            }
+            
+            jobFinished.wait(50);
+        }
+    }
+    
+    /**
+     * True if the job running on the calling thread should bail out
+     */
+    static bool shouldCurrentJobStop()
+    {
+        if (juce::Thread::currentThreadShouldExit())
+            return true;
+        
+        auto* engine = getLiveInstance().load();
+        
+        if (engine == nullptr || juce::Thread::getCurrentThreadId() != engine->getThreadId())
+            return false;
+        
+        const juce::ScopedLock lock(engine->queueLock);
+        return engine->currentCancelled;
+    }
+    
+    /**
+     * Pool for parallel range workers; shared by all downloads
+     */
+    juce::ThreadPool& getTransferPool() { return transferPool; }
+    
+    //==========================================================================
+    // CONNECTION HELPERS
+    //==========================================================================
+    
+    /**
+     * Follow redirects once with HEAD and cache the final URL, so range
+     * workers and retries hit the CDN directly instead of paying the
+     * github.com redirect round trip on every request.
+     */
+    juce::String resolveRedirects(const juce::String& url)
+    {
+        auto now = juce::Time::getMillisecondCounter();
+        
+        {
+            const juce::ScopedLock lock(redirectLock);
+            auto it = redirectCache.find(url);
+            
+            if (it != redirectCache.end()
+                && now - it->second.resolvedAt < (juce::uint32) UpdaterConfig::REDIRECT_CACHE_MS)
+                return it->second.target;
+        }
+        
+        juce::String target = url;
+        
+        for (int hop = 0; hop < 5; ++hop)
+        {
+            juce::StringPairArray headers;
+            int statusCode = 0;
+            
+            auto stream = juce::URL(target).createInputStream(
+                juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                    .withHttpRequestCmd("HEAD")
+                    .withNumRedirectsToFollow(0)
+                    .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                    .withResponseHeaders(&headers)
+                    .withStatusCode(&statusCode)
+            );
+            
+            auto location = headers.getValue("Location", {});
+            
+            if (statusCode < 300 || statusCode >= 400 || !location.startsWithIgnoreCase("http"))
+                break;
+            
+            target = location;
+        }
+        
+        if (target != url)
+            UpdaterConfig::logMessage("Resolved redirect: " + target.upToFirstOccurrenceOf("?", false, false));
+        
+        const juce::ScopedLock lock(redirectLock);
+        redirectCache[url] = { target, now };
+        
+        return target;
+    }
+    
+    /**
+     * Warm DNS and TLS session caches for the API host in the background.
+     * /rate_limit doesn't count against the unauthenticated quota.
+     */
+    void prewarm()
+    {
+        post(nullptr, []
+        {
+            auto start = juce::Time::getMillisecondCounter();
+            int statusCode = 0;
+            
+            juce::URL("https://api.github.com/rate_limit").createInputStream(
+                juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                    .withHttpRequestCmd("HEAD")
+                    .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                    .withStatusCode(&statusCode)
+            );
+            
+            UpdaterConfig::logMessage("Network pre-warm: status " + juce::String(statusCode) + " in " +
+                                    juce::String(juce::Time::getMillisecondCounter() - start) + " ms");
+        });
+    }
+
+private:
+    //==========================================================================
+    
+    struct Entry
+    {
+        const void* owner = nullptr;
+        Job job;
+    };
+    
+    struct Redirect
+    {
+        juce::String target;
+        juce::uint32 resolvedAt = 0;
+    };
+    
+    NetworkEngine()
+        : juce::Thread("NetworkEngine"),
+          transferPool(UpdaterConfig::DOWNLOAD_SEGMENTS)
+    {
+        getLiveInstance() = this;
+        startThread();
+    }
+    
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            Entry entry;
+            
+            {
+                const juce::ScopedLock lock(queueLock);
+                
+                if (!queue.empty())
+                {
+                    entry = std::move(queue.front());
+                    queue.pop_front();
+                    
+                    currentOwner = entry.owner;
+                    currentCancelled = false;
+                }
+            }
+            
+            if (!entry.job)
+            {
+                wait(-1);
+                continue;
+            }
+            
+            entry.job();
+            
+            {
+                const juce::ScopedLock lock(queueLock);
+                currentOwner = nullptr;
+            }
+            
+            jobFinished.signal();
+        }
+    }
+    
+    //==========================================================================
+    
+    static juce::SpinLock& getInstanceLock()
+    {
+        static juce::SpinLock lock;
+        return lock;
+    }
+    
+    static std::atomic<NetworkEngine*>& getLiveInstance()
+    {
+        static std::atomic<NetworkEngine*> live { nullptr };
+        return live;
+    }
+    
+    static std::unique_ptr<NetworkEngine>& getInstancePointer()
+    {
+        static std::unique_ptr<NetworkEngine> instance;
+        return instance;
+    }
+    
+    //==========================================================================
+    
+    juce::CriticalSection queueLock;
+    std::deque<Entry> queue;
+    const void* currentOwner = nullptr;
+    bool currentCancelled = false;
+    juce::WaitableEvent jobFinished;
+    
+    juce::CriticalSection redirectLock;
+    std::map<juce::String, Redirect> redirectCache;
+    
+    juce::ThreadPool transferPool;
+    
+    JUCE_DECLARE_NON_COPYABLE(NetworkEngine)
+};
\ No newline at end of file
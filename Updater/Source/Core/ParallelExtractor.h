@@ -0,0 +1,240 @@
+/*
+  ParallelExtractor.h - Decompress zip entries on every core
+  
+  Each zip entry is an independent deflate stream, so entries are
+  handed out to a pool with one thread per core and written straight
+  to their final paths, decoded from the archive's memory mapping.
+  Stored entries are written from the mapping as they are. The
+  largest entries are queued first, so a big binary doesn't start
+  last while the other threads sit idle. Every entry is checked
+  against its CRC-32 and size and gets its own result.
+  
+  While a DAW is running a single thread is used, like the rest of the
+  updater's background work.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "Inflate.h"
+#include "NetworkEngine.h"
+#include "ResourceGovernor.h"
+#include "ZipArchive.h"
+
+class ParallelExtractor
+{
+public:
+    struct EntryResult
+    {
+        juce::String path;
+        bool ok = false;
+        juce::uint32 expectedCrc = 0;
+        juce::uint32 actualCrc = 0;
+        juce::String error;             // Empty if ok
+    };
+    
+    /**
+     * Extract the entries of archive at indices into destDir.
+     * Directories are created up front; files are decoded on the pool.
+     * numThreads <= 0 uses EXTRACT_THREADS (0 there = one per core).
+     * Returns one result per file entry, in archive order.
+     */
+    static juce::Array<EntryResult> extract(const ZipArchive& archive,
+                                           const juce::Array<int>& indices,
+                                           const juce::File& destDir,
+                                           int numThreads = 0)
+    {
+        auto& entries = archive.getEntries();
+        juce::Array<int> files;
+        juce::int64 totalBytes = 0;
+        
+        for (auto index : indices)
+        {
+            auto& entry = entries.getReference(index);
+            auto target = destDir.getChildFile(entry.path);
+            
+            if (entry.isDirectory)
+            {
+                target.createDirectory();
+                continue;
+            }
+            
+            target.getParentDirectory().createDirectory();
+            files.add(index);
+            totalBytes += entry.size;
+        }
+        
+        juce::Array<EntryResult> results;
+        juce::Array<int> order;
+        
+        for (int i = 0; i < files.size(); ++i)
+        {
+            EntryResult result;
+            result.path = entries.getReference(files[i]).path;
+            result.expectedCrc = entries.getReference(files[i]).crc;
+            result.error = "cancelled";
+            results.add(result);
+            order.add(i);
+        }
+        
+        std::sort(order.begin(), order.end(), [&](int a, int b)
+        {
+            return entries.getReference(files[a]).compressedSize > entries.getReference(files[b]).compressedSize;
+        });
+        
+        auto threads = getThreadCount(numThreads, files.size());
+        auto startMs = juce::Time::getMillisecondCounterHiRes();
+        
+        {
+            juce::ThreadPool pool(threads);
+            juce::OwnedArray<EntryJob> jobs;
+            
+            for (auto i : order)
+                pool.addJob(jobs.add(new EntryJob(archive, entries.getReference(files[i]),
+                                                  destDir, results.getReference(i))), false);
+            
+            for (auto* job : jobs)
+            {
+                while (!pool.waitForJobToFinish(job, 100))
+                {
+                    if (NetworkEngine::shouldCurrentJobStop())
+                        pool.removeAllJobs(true, -1);
+                }
+            }
+        }
+        
+        UpdaterConfig::logMessage("Decompressed " + juce::String(files.size()) + " entries (" +
+                                juce::String(totalBytes) + " bytes) in " +
+                                juce::String(juce::roundToInt(juce::Time::getMillisecondCounterHiRes() - startMs)) +
+                                " ms on " + juce::String(threads) + " thread(s)");
+        return results;
+    }
+
+private:
+    static constexpr size_t writeChunkSize = 1024 * 1024;   // Cancel checks between writes
+    
+    static int getThreadCount(int requested, int numFiles)
+    {
+        return ResourceGovernor::getThreadCount(requested > 0 ? requested : UpdaterConfig::EXTRACT_THREADS, numFiles);
+    }
+    
+    //==========================================================================
+    // ENTRY WORKER
+    //==========================================================================
+    
+    class EntryJob : public juce::ThreadPoolJob
+    {
+    public:
+        EntryJob(const ZipArchive& archiveRef, const ZipArchive::Entry& entryRef,
+                 const juce::File& destDir, EntryResult& resultRef)
+            : juce::ThreadPoolJob("Extract " + entryRef.path),
+              archive(archiveRef),
+              entry(entryRef),
+              target(destDir.getChildFile(entryRef.path)),
+              result(resultRef)
+        {
+        }
+        
+        JobStatus runJob() override
+        {
+            ResourceGovernor::ScopedBackgroundWork governed(ResourceGovernor::ThreadLife::perPass);
+            
+            result.error = decode();
+            result.ok = result.error.isEmpty();
+            
+            if (!result.ok)
+                target.deleteFile();
+            
+            return jobHasFinished;
+        }
+    
+    private:
+        /**
+         * Returns an error, or empty on success
+         */
+        juce::String decode()
+        {
+            if (entry.isEncrypted)
+                return "encrypted";
+            
+            if (entry.method != 0 && entry.method != 8)
+                return "unsupported compression method " + juce::String(entry.method);
+            
+            auto* source = archive.getEntryData(entry);
+            
+            if (source == nullptr)
+                return "bad local header";
+            
+            target.deleteFile();
+            juce::FileOutputStream out(target);
+            
+            if (out.failedToOpen())
+                return "can't write " + target.getFullPathName();
+            
+            Crc32 crc;
+            juce::int64 written = 0;
+            
+            auto sink = [&](const juce::uint8* data, size_t numBytes)
+            {
+                crc.update(data, numBytes);
+                written += (juce::int64) numBytes;
+                return !shouldExit() && out.write(data, numBytes);
+            };
+            
+            if (entry.method == 0)
+            {
+                for (juce::int64 done = 0; done < entry.compressedSize;)
+                {
+                    auto n = (size_t) juce::jmin<juce::int64>((juce::int64) writeChunkSize, entry.compressedSize - done);
+                    
+                    if (!sink(source + done, n))
+                        return shouldExit() ? "cancelled" : "write failed";
+                    
+                    done += (juce::int64) n;
+                }
+            }
+            else
+            {
+                // The whole entry is already in the mapping; the local
+                // header in front of it covers the Inflater's look-behind
+                Inflater::Input input;
+                input.next = source;
+                input.end = source + entry.compressedSize;
+                input.refill = [](Inflater::Input&) { return false; };
+                
+                auto decoded = Inflater().run(input, sink);
+                
+                if (decoded == Inflater::Result::outputFailed)
+                    return shouldExit() ? "cancelled" : "write failed";
+                
+                if (decoded != Inflater::Result::ok)
+                    return "corrupt data";
+            }
+            
+            out.flush();
+            result.actualCrc = crc.get();
+            
+            if (!out.getStatus().wasOk())
+                return "write failed";
+            
+            if (written != entry.size)
+                return "size mismatch (" + juce::String(written) + " of " + juce::String(entry.size) + " bytes)";
+            
+            if (result.actualCrc != entry.crc)
+                return "CRC mismatch";
+            
+            // Bundles carry their executable bit
+            if ((entry.mode & 0111) != 0)
+                target.setExecutePermission(true);
+            
+            return {};
+        }
+        
+        const ZipArchive& archive;
+        const ZipArchive::Entry& entry;
+        juce::File target;
+        EntryResult& result;
+        
+        JUCE_DECLARE_NON_COPYABLE(EntryJob)
+    };
+};
\ No newline at end of file
@@ -103,6 +103,8 @@ private:
             return isProcessRunningWindows(processName);
         #elif JUCE_MAC
             return isProcessRunningMac(processName);
+        #elif JUCE_LINUX
+            return isProcessRunningLinux(processName);
         #else
             return false;
         #endif
@@ -146,4 +148,28 @@ private:
         return false;
     }
     #endif
+
+    #if JUCE_LINUX
+    static bool isProcessRunningLinux(const juce::String& processName)
+    {
+        // Scan /proc/<pid>/comm directly instead of spawning ps
+        auto pattern = processName.upToLastOccurrenceOf(".exe", false, true);
+        
+        for (const auto& entry : juce::RangedDirectoryIterator(juce::File("/proc"), false, "*",
+                                                               juce::File::findDirectories))
+        {
+            auto dir = entry.getFile();
+            
+            if (!dir.getFileName().containsOnly("0123456789"))
+                continue;
+            
+            auto comm = dir.getChildFile("comm").loadFileAsString().trim();
+            
+            if (comm.isNotEmpty() && comm.matchesWildcard(pattern, true))
+                return true;
+        }
+        
+        return false;
+    }
+    #endif
 };
\ No newline at end of file
@@ -0,0 +1,282 @@
+/*
+  ReleaseIndex.h - Local index of the repository's releases
+  
+  Keeps every release seen so far (id, tag, flags, notes, assets and
+  digests) on disk, plus the validators of the first /releases page.
+  GitHubAPI syncs it incrementally (conditional first page, then only
+  as many pages as needed to reach a known release id); channel
+  queries are answered from memory without touching the network.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <set>
+#include "../Config.h"
+#include "ReleaseInfo.h"
+
+class ReleaseIndex
+{
+public:
+    //==========================================================================
+    // QUERIES (no network)
+    //==========================================================================
+    
+    /**
+     * Newest published release of the channel (stable, or stable + beta)
+     * Returns an invalid struct if the index has none
+     */
+    static ReleaseInfo getLatest(bool includePrereleases)
+    {
+        const juce::ScopedLock lock(getLock());
+        auto& state = getState();
+        
+        auto index = includePrereleases ? state.latestAny : state.latestStable;
+        return index >= 0 ? state.releases.getReference(index) : ReleaseInfo();
+    }
+    
+    static bool contains(juce::int64 releaseId)
+    {
+        const juce::ScopedLock lock(getLock());
+        return getState().knownIds.count(releaseId) > 0;
+    }
+    
+    static bool isEmpty()
+    {
+        const juce::ScopedLock lock(getLock());
+        return getState().releases.isEmpty();
+    }
+    
+    /**
+     * If-None-Match / If-Modified-Since for the first /releases page
+     */
+    static juce::String getConditionalHeaders()
+    {
+        const juce::ScopedLock lock(getLock());
+        auto& state = getState();
+        juce::String headers;
+        
+        if (state.releases.isEmpty())
+            return headers;
+        
+        if (state.etag.isNotEmpty())
+            headers << "If-None-Match: " << state.etag << "\r\n";
+        
+        if (state.lastModified.isNotEmpty())
+            headers << "If-Modified-Since: " << state.lastModified << "\r\n";
+        
+        return headers;
+    }
+    
+    //==========================================================================
+    // UPDATING
+    //==========================================================================
+    
+    /**
+     * Merge freshly fetched releases (replacing known ids, since assets
+     * can be added after publishing) and store the first page's validators
+     */
+    static void merge(const juce::Array<ReleaseInfo>& fresh,
+                      const juce::String& etag,
+                      const juce::String& lastModified)
+    {
+        const juce::ScopedLock lock(getLock());
+        auto& state = getState();
+        
+        for (auto& release : fresh)
+        {
+            if (release.id == 0)
+                continue;
+            
+            bool replaced = false;
+            
+            for (auto& existing : state.releases)
+            {
+                if (existing.id == release.id)
+                {
+                    existing = release;
+                    replaced = true;
+                    break;
+                }
+            }
+            
+            if (!replaced)
+                state.releases.add(release);
+        }
+        
+        state.etag = etag;
+        state.lastModified = lastModified;
+        rebuild(state);
+        
+        if (!writeToDisk(state))
+            UpdaterConfig::logMessage("WARNING: Failed to write release index");
+    }
+    
+    /**
+     * Drop the index (memory and disk)
+     */
+    static void clear()
+    {
+        const juce::ScopedLock lock(getLock());
+        getState() = State();
+        UpdaterConfig::getReleaseIndexFile().deleteFile();
+    }
+
+private:
+    //==========================================================================
+    
+    struct State
+    {
+        juce::Array<ReleaseInfo> releases;  // Newest first
+        std::set<juce::int64> knownIds;
+        int latestStable = -1;              // Index into releases
+        int latestAny = -1;
+        juce::String etag;
+        juce::String lastModified;
+    };
+    
+    /**
+     * Re-sort and recompute the per-channel answers
+     */
+    static void rebuild(State& state)
+    {
+        struct NewestFirst
+        {
+            static int compareElements(const ReleaseInfo& a, const ReleaseInfo& b)
+            {
+                if (a.releaseDate != b.releaseDate)
+                    return a.releaseDate > b.releaseDate ? -1 : 1;
+                
+                return a.id > b.id ? -1 : (a.id < b.id ? 1 : 0);
+            }
+        };
+        
+        NewestFirst comparator;
+        state.releases.sort(comparator, true);
+        
+        state.knownIds.clear();
+        state.latestStable = -1;
+        state.latestAny = -1;
+        
+        for (int i = 0; i < state.releases.size(); ++i)
+        {
+            auto& release = state.releases.getReference(i);
+            state.knownIds.insert(release.id);
+            
+            if (release.isDraft || !release.isValid())
+                continue;
+            
+            if (state.latestAny < 0)
+                state.latestAny = i;
+            
+            if (state.latestStable < 0 && !release.isPrerelease)
+                state.latestStable = i;
+        }
+    }
+    
+    //==========================================================================
+    // PERSISTENCE
+    //==========================================================================
+    
+    static State readFromDisk()
+    {
+        State state;
+        auto xml = juce::parseXML(UpdaterConfig::getReleaseIndexFile());
+        
+        if (xml == nullptr || !xml->hasTagName("ReleaseIndex"))
+            return state;
+        
+        state.etag = xml->getStringAttribute("etag");
+        state.lastModified = xml->getStringAttribute("lastModified");
+        
+        for (auto* rel : xml->getChildWithTagNameIterator("Release"))
+        {
+            ReleaseInfo release;
+            release.id = rel->getStringAttribute("id").getLargeIntValue();
+            release.version = rel->getStringAttribute("version");
+            release.tagName = rel->getStringAttribute("tagName");
+            release.downloadUrl = rel->getStringAttribute("downloadUrl");
+            release.releaseDate = juce::Time::fromISO8601(rel->getStringAttribute("releaseDate"));
+            release.isPrerelease = rel->getBoolAttribute("isPrerelease");
+            release.isDraft = rel->getBoolAttribute("isDraft");
+            release.fileSize = rel->getStringAttribute("fileSize").getLargeIntValue();
+            release.sha256 = rel->getStringAttribute("sha256");
+            release.checksumUrl = rel->getStringAttribute("checksumUrl");
+            
+            if (auto* notes = rel->getChildByName("Changelog"))
+                release.changelog = notes->getAllSubText();
+            
+            for (auto* a : rel->getChildWithTagNameIterator("Asset"))
+            {
+                ReleaseInfo::Asset asset;
+                asset.name = a->getStringAttribute("name");
+                asset.downloadUrl = a->getStringAttribute("url");
+                asset.size = a->getStringAttribute("size").getLargeIntValue();
+                asset.digest = a->getStringAttribute("digest");
+                release.assets.add(asset);
+            }
+            
+            if (release.id != 0)
+                state.releases.add(release);
+        }
+        
+        rebuild(state);
+        return state;
+    }
+    
+    static bool writeToDisk(const State& state)
+    {
+        juce::XmlElement xml("ReleaseIndex");
+        xml.setAttribute("etag", state.etag);
+        xml.setAttribute("lastModified", state.lastModified);
+        
+        for (auto& release : state.releases)
+        {
+            auto* rel = xml.createNewChildElement("Release");
+            rel->setAttribute("id", juce::String(release.id));
+            rel->setAttribute("version", release.version);
+            rel->setAttribute("tagName", release.tagName);
+            rel->setAttribute("downloadUrl", release.downloadUrl);
+            rel->setAttribute("releaseDate", release.releaseDate.toISO8601(true));
+            rel->setAttribute("isPrerelease", release.isPrerelease);
+            rel->setAttribute("isDraft", release.isDraft);
+            rel->setAttribute("fileSize", juce::String(release.fileSize));
+            rel->setAttribute("sha256", release.sha256);
+            rel->setAttribute("checksumUrl", release.checksumUrl);
+            rel->createNewChildElement("Changelog")->addTextElement(release.changelog);
+            
+            for (auto& asset : release.assets)
+            {
+                auto* a = rel->createNewChildElement("Asset");
+                a->setAttribute("name", asset.name);
+                a->setAttribute("url", asset.downloadUrl);
+                a->setAttribute("size", juce::String(asset.size));
+                a->setAttribute("digest", asset.digest);
+            }
+        }
+        
+        auto file = UpdaterConfig::getReleaseIndexFile();
+        file.getParentDirectory().createDirectory();
+        
+        juce::TemporaryFile temp(file);
+        
+        return xml.writeTo(temp.getFile())
+            && temp.overwriteTargetFileWithTemporary();
+    }
+    
+    //==========================================================================
+    
+    static juce::CriticalSection& getLock()
+    {
+        static juce::CriticalSection lock;
+        return lock;
+    }
+    
+    /**
+     * Loaded from disk on first use
+     */
+    static State& getState()
+    {
+        static State state = readFromDisk();
+        return state;
+    }
+};
\ No newline at end of file
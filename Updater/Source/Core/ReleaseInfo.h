@@ -0,0 +1,43 @@
+/*
+  ReleaseInfo.h - Parsed GitHub release description
+  
+  Shared between GitHubAPI (parsing) and ReleaseIndex (persistence)
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+
+struct ReleaseInfo
+{
+    struct Asset
+    {
+        juce::String name;           // e.g., "samp-windows-x64.zip"
+        juce::String downloadUrl;    // browser_download_url
+        juce::int64 size = 0;        // Size in bytes
+        juce::String digest;         // e.g., "sha256:<hex>" (empty on older releases)
+    };
+    
+    juce::int64 id = 0;          // GitHub release id (stable across edits)
+    juce::String version;        // e.g., "1.0.1" (without 'v')
+    juce::String tagName;        // e.g., "v1.0.1"
+    juce::String downloadUrl;    // Direct download URL for .vst3 file
+    juce::String changelog;      // Release notes/body
+    juce::Time releaseDate;      // When released
+    bool isPrerelease = false;   // Is it a beta/prerelease
+    bool isDraft = false;        // Unpublished (only visible with auth)
+    juce::int64 fileSize = 0;    // Size in bytes
+    juce::String sha256;         // Published SHA-256 of the download (lowercase hex)
+    juce::String checksumUrl;    // ".sha256" sidecar asset, if sha256 isn't known yet
+    juce::Array<Asset> assets;   // All assets attached to the release
+    
+    bool isValid() const
+    {
+        return version.isNotEmpty() && downloadUrl.isNotEmpty();
+    }
+    
+    juce::String getFileSizeString() const
+    {
+        double mb = fileSize / (1024.0 * 1024.0);
+        return juce::String(mb, 1) + " MB";
+    }
+};
\ No newline at end of file
@@ -0,0 +1,542 @@
+/*
+  ReleaseJsonReader.h - Streaming field extractor for GitHub release JSON
+  
+  Pulls only the fields the updater needs (id, tag, draft/prerelease
+  flags, dates, notes, asset names/URLs/sizes/digests) straight out of
+  the byte stream, for a single release or a /releases page.
+  Everything else (uploader objects, reactions, unknown keys) is skipped
+  without being materialised, and reading stops as soon as all wanted
+  fields have been seen.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <string>
+#include "ReleaseInfo.h"
+
+class ReleaseJsonReader
+{
+public:
+    explicit ReleaseJsonReader(juce::InputStream& sourceStream)
+        : source(sourceStream)
+    {
+        scratch.reserve(256);
+        key.reserve(64);
+    }
+    
+    /**
+     * Parse one release object from the stream
+     * stopEarly: return as soon as every wanted field was seen, leaving
+     * the rest of the object unread (only for a lone object)
+     * Returns false on malformed input
+     */
+    bool readRelease(ReleaseInfo& info, bool stopEarly = true)
+    {
+        enum : int
+        {
+            hasTag = 1 << 0,
+            hasPrerelease = 1 << 1,
+            hasPublished = 1 << 2,
+            hasBody = 1 << 3,
+            hasAssets = 1 << 4,
+            hasId = 1 << 5,
+            hasDraft = 1 << 6,
+            hasEverything = (1 << 7) - 1
+        };
+        
+        int found = 0;
+        
+        if (!consume('{'))
+            return false;
+        
+        if (consume('}'))
+            return true;
+        
+        for (;;)
+        {
+            if (!readKey())
+                return false;
+            
+            if (key == "id")
+            {
+                if (!readLiteral(scratch))
+                    return false;
+                
+                info.id = std::strtoll(scratch.c_str(), nullptr, 10);
+                found |= hasId;
+            }
+            else if (key == "draft")
+            {
+                if (!readLiteral(scratch))
+                    return false;
+                
+                info.isDraft = (scratch == "true");
+                found |= hasDraft;
+            }
+            else if (key == "tag_name")
+            {
+                if (!readStringOrNull(scratch))
+                    return false;
+                
+                info.tagName = toJuceString(scratch);
+                info.version = info.tagName.trimCharactersAtStart("v");
+                found |= hasTag;
+            }
+            else if (key == "prerelease")
+            {
+                if (!readLiteral(scratch))
+                    return false;
+                
+                info.isPrerelease = (scratch == "true");
+                found |= hasPrerelease;
+            }
+            else if (key == "published_at")
+            {
+                if (!readStringOrNull(scratch))
+                    return false;
+                
+                info.releaseDate = juce::Time::fromISO8601(toJuceString(scratch));
+                found |= hasPublished;
+            }
+            else if (key == "body")
+            {
+                if (!readStringOrNull(scratch))
+                    return false;
+                
+                info.changelog = toJuceString(scratch);
+                found |= hasBody;
+            }
+            else if (key == "assets")
+            {
+                if (!readAssets(info))
+                    return false;
+                
+                found |= hasAssets;
+            }
+            else if (!skipValue())
+            {
+                return false;
+            }
+            
+            // Early out: the rest of the object is of no interest
+            if (stopEarly && found == hasEverything)
+                return true;
+            
+            if (consume(','))
+                continue;
+            
+            return consume('}');
+        }
+    }
+    
+    /**
+     * Parse a page of releases (JSON array), newest first as GitHub sends them
+     * Returns false on malformed input
+     */
+    bool readReleaseList(juce::Array<ReleaseInfo>& releases)
+    {
+        if (!consume('['))
+            return false;
+        
+        if (consume(']'))
+            return true;
+        
+        for (;;)
+        {
+            ReleaseInfo info;
+            
+            if (!readRelease(info, false))
+                return false;
+            
+            releases.add(info);
+            
+            if (consume(','))
+                continue;
+            
+            return consume(']');
+        }
+    }
+
+private:
+    //==========================================================================
+    // STRUCTURE
+    //==========================================================================
+    
+    bool readAssets(ReleaseInfo& info)
+    {
+        if (consume('n'))
+            return expectLiteralTail("ull");
+        
+        if (!consume('['))
+            return false;
+        
+        if (consume(']'))
+            return true;
+        
+        for (;;)
+        {
+            ReleaseInfo::Asset asset;
+            
+            if (!readAsset(asset))
+                return false;
+            
+            info.assets.add(asset);
+            
+            if (consume(','))
+                continue;
+            
+            return consume(']');
+        }
+    }
+    
+    bool readAsset(ReleaseInfo::Asset& asset)
+    {
+        if (!consume('{'))
+            return false;
+        
+        if (consume('}'))
+            return true;
+        
+        for (;;)
+        {
+            if (!readKey())
+                return false;
+            
+            if (key == "name")
+            {
+                if (!readStringOrNull(scratch))
+                    return false;
+                
+                asset.name = toJuceString(scratch);
+            }
+            else if (key == "browser_download_url")
+            {
+                if (!readStringOrNull(scratch))
+                    return false;
+                
+                asset.downloadUrl = toJuceString(scratch);
+            }
+            else if (key == "size")
+            {
+                if (!readLiteral(scratch))
+                    return false;
+                
+                asset.size = std::strtoll(scratch.c_str(), nullptr, 10);
+            }
+            else if (key == "digest")
+            {
+                if (!readStringOrNull(scratch))
+                    return false;
+                
+                asset.digest = toJuceString(scratch);
+            }
+            else if (!skipValue())
+            {
+                return false;
+            }
+            
+            if (consume(','))
+                continue;
+            
+            return consume('}');
+        }
+    }
+    
+    bool readKey()
+    {
+        skipWhitespace();
+        return readString(&key) && consume(':');
+    }
+    
+    //==========================================================================
+    // VALUES
+    //==========================================================================
+    
+    bool readStringOrNull(std::string& out)
+    {
+        skipWhitespace();
+        
+        if (peek() == 'n')
+        {
+            bool ok = readLiteral(out);
+            out.clear();
+            return ok;
+        }
+        
+        return readString(&out);
+    }
+    
+    /**
+     * Read a JSON string; pass nullptr to skip it without storing
+     */
+    bool readString(std::string* out)
+    {
+        if (next() != '"')
+            return false;
+        
+        if (out != nullptr)
+            out->clear();
+        
+        for (;;)
+        {
+            // Copy plain runs straight from the buffer
+            if (pos == end && !refill())
+                return false;
+            
+            int start = pos;
+            
+            while (pos < end && buffer[pos] != '"' && buffer[pos] != '\\')
+                ++pos;
+            
+            if (out != nullptr)
+                out->append(buffer + start, (size_t) (pos - start));
+            
+            if (pos == end)
+                continue;
+            
+            if (buffer[pos++] == '"')
+                return true;
+            
+            // Escape sequence
+            int e = next();
+            
+            if (e < 0)
+                return false;
+            
+            if (e == 'u')
+            {
+                juce::uint32 codePoint = 0;
+                
+                if (!readHex4(codePoint))
+                    return false;
+                
+                // Surrogate pair
+                if (codePoint >= 0xd800 && codePoint < 0xdc00 && peek() == '\\')
+                {
+                    next();
+                    
+                    juce::uint32 low = 0;
+                    
+                    if (next() != 'u' || !readHex4(low))
+                        return false;
+                    
+                    if (low >= 0xdc00 && low < 0xe000)
+                        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+                
+                if (out != nullptr)
+                    appendUTF8(*out, codePoint);
+                
+                continue;
+            }
+            
+            if (out == nullptr)
+                continue;
+            
+            switch (e)
+            {
+                case 'b': out->push_back('\b'); break;
+                case 'f': out->push_back('\f'); break;
+                case 'n': out->push_back('\n'); break;
+                case 'r': out->push_back('\r'); break;
+                case 't': out->push_back('\t'); break;
+                default:  out->push_back((char) e); break;
+            }
+        }
+    }
+    
+    /**
+     * Read number / true / false / null token
+     */
+    bool readLiteral(std::string& out)
+    {
+        skipWhitespace();
+        out.clear();
+        
+        while (isLiteralChar(peek()))
+            out.push_back((char) next());
+        
+        return !out.empty();
+    }
+    
+    bool expectLiteralTail(const char* tail)
+    {
+        for (; *tail != 0; ++tail)
+            if (next() != *tail)
+                return false;
+        
+        return true;
+    }
+    
+    /**
+     * Skip any value (including nested objects/arrays) without storing it
+     */
+    bool skipValue()
+    {
+        skipWhitespace();
+        int depth = 0;
+        
+        do
+        {
+            int c = peek();
+            
+            if (c < 0)
+                return false;
+            
+            if (c == '"')
+            {
+                if (!readString(nullptr))
+                    return false;
+            }
+            else if (c == '{' || c == '[')
+            {
+                next();
+                ++depth;
+            }
+            else if (c == '}' || c == ']')
+            {
+                next();
+                
+                if (--depth < 0)
+                    return false;
+            }
+            else if (c == ',' || c == ':' || isWhitespace(c))
+            {
+                next();
+            }
+            else if (isLiteralChar(c))
+            {
+                while (isLiteralChar(peek()))
+                    next();
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while (depth > 0);
+        
+        return true;
+    }
+    
+    //==========================================================================
+    // INPUT
+    //==========================================================================
+    
+    int peek()
+    {
+        if (pos == end && !refill())
+            return -1;
+        
+        return (unsigned char) buffer[pos];
+    }
+    
+    int next()
+    {
+        int c = peek();
+        
+        if (c >= 0)
+            ++pos;
+        
+        return c;
+    }
+    
+    bool refill()
+    {
+        pos = 0;
+        end = juce::jmax(0, source.read(buffer, (int) sizeof(buffer)));
+        return end > 0;
+    }
+    
+    void skipWhitespace()
+    {
+        while (isWhitespace(peek()))
+            ++pos;
+    }
+    
+    bool consume(char expected)
+    {
+        skipWhitespace();
+        
+        if (peek() != (unsigned char) expected)
+            return false;
+        
+        ++pos;
+        return true;
+    }
+    
+    bool readHex4(juce::uint32& value)
+    {
+        value = 0;
+        
+        for (int i = 0; i < 4; ++i)
+        {
+            int digit = juce::CharacterFunctions::getHexDigitValue((juce::juce_wchar) next());
+            
+            if (digit < 0)
+                return false;
+            
+            value = (value << 4) | (juce::uint32) digit;
+        }
+        
+        return true;
+    }
+    
+    //==========================================================================
+    // HELPERS
+    //==========================================================================
+    
+    static bool isWhitespace(int c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+    
+    static bool isLiteralChar(int c)
+    {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || c == '-' || c == '+' || c == '.';
+    }
+    
+    static void appendUTF8(std::string& out, juce::uint32 cp)
+    {
+        if (cp < 0x80)
+        {
+            out.push_back((char) cp);
+        }
+        else if (cp < 0x800)
+        {
+            out.push_back((char) (0xc0 | (cp >> 6)));
+            out.push_back((char) (0x80 | (cp & 0x3f)));
+        }
+        else if (cp < 0x10000)
+        {
+            out.push_back((char) (0xe0 | (cp >> 12)));
+            out.push_back((char) (0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back((char) (0x80 | (cp & 0x3f)));
+        }
+        else
+        {
+            out.push_back((char) (0xf0 | (cp >> 18)));
+            out.push_back((char) (0x80 | ((cp >> 12) & 0x3f)));
+            out.push_back((char) (0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back((char) (0x80 | (cp & 0x3f)));
+        }
+    }
+    
+    static juce::String toJuceString(const std::string& s)
+    {
+        return juce::String::fromUTF8(s.data(), (int) s.size());
+    }
+    
+    //==========================================================================
+    
+    juce::InputStream& source;
+    char buffer[8192];
+    int pos = 0;
+    int end = 0;
+    
+    std::string key;        // Reused for every object key
+    std::string scratch;    // Reused for every kept value
+    
+    JUCE_DECLARE_NON_COPYABLE(ReleaseJsonReader)
+};
\ No newline at end of file
@@ -0,0 +1,316 @@
+/*
+  RequestScheduler.h - Polite access to the GitHub API
+  
+  Handles:
+  - Reading X-RateLimit-Remaining / X-RateLimit-Reset / Retry-After and
+    deferring further API requests until the limit resets
+  - Retrying transient failures (5xx, timeouts, dropped connections)
+    with exponential backoff and jitter
+  - Picking randomised automatic check times so many installs don't
+    all hit the API in the same minute
+  
+  The deferral and the time of the last check survive restarts, so
+  relaunching the updater doesn't reset the clock.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "NetworkEngine.h"
+
+class RequestScheduler
+{
+public:
+    struct Response
+    {
+        std::unique_ptr<juce::InputStream> stream;
+        int statusCode = 0;
+        juce::StringPairArray headers;
+        bool deferred = false;      // Not sent (or given up): rate limit in force
+    };
+    
+    //==========================================================================
+    // API REQUESTS
+    //==========================================================================
+    
+    /**
+     * Send an API request, waiting out short rate limits and retrying
+     * transient failures. Returns the last response; check deferred
+     * before treating a missing stream as an error.
+     */
+    static Response send(const juce::URL& url, const juce::String& extraHeaders)
+    {
+        Response response;
+        
+        for (int attempt = 0;; ++attempt)
+        {
+            auto waitMs = getDeferralMs();
+            
+            if (waitMs > UpdaterConfig::API_MAX_INLINE_WAIT_MS)
+            {
+                UpdaterConfig::logMessage("API rate limited until " + getDeferredUntil().toString(false, true) +
+                                        ", deferring request");
+                response = Response();
+                response.deferred = true;
+                return response;
+            }
+            
+            if (waitMs > 0 && !sleep(waitMs))
+                return response;
+            
+            response = Response();
+            
+            response.stream = url.createInputStream(
+                juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+                    .withExtraHeaders(extraHeaders)
+                    .withConnectionTimeoutMs(UpdaterConfig::HTTP_TIMEOUT_MS)
+                    .withResponseHeaders(&response.headers)
+                    .withStatusCode(&response.statusCode)
+            );
+            
+            auto limited = readRateLimit(response.statusCode, response.headers);
+            
+            if (!limited && !isTransient(response))
+                return response;
+            
+            if (attempt >= UpdaterConfig::API_MAX_RETRIES)
+            {
+                response.deferred = limited;
+                return response;
+            }
+            
+            if (limited)
+                continue;   // Loop top waits or defers
+            
+            auto backoffMs = getBackoffMs(attempt);
+            
+            UpdaterConfig::logMessage("API request failed (status " + juce::String(response.statusCode) +
+                                    "), retrying in " + juce::String(backoffMs) + " ms");
+            
+            if (!sleep(backoffMs))
+                return response;
+        }
+    }
+    
+    /**
+     * True while the rate limit says not to call the API
+     */
+    static bool isDeferred()
+    {
+        return getDeferralMs() > 0;
+    }
+    
+    static juce::Time getDeferredUntil()
+    {
+        const juce::ScopedLock lock(getLock());
+        return juce::Time(getState().deferredUntil);
+    }
+    
+    //==========================================================================
+    // AUTOMATIC CHECKS
+    //==========================================================================
+    
+    /**
+     * Record a completed check (successful or not) as the base of the next one
+     */
+    static void markChecked()
+    {
+        const juce::ScopedLock lock(getLock());
+        getState().lastCheck = juce::Time::currentTimeMillis();
+        save();
+    }
+    
+    /**
+     * Milliseconds until the next automatic check: the check interval
+     * plus or minus CHECK_JITTER_MINUTES, but never before a rate limit
+     * resets. An overdue check is still spread over the first
+     * CHECK_JITTER_MINUTES so a fleet starting together doesn't sync up.
+     */
+    static int getNextCheckDelayMs()
+    {
+        const juce::ScopedLock lock(getLock());
+        auto& state = getState();
+        
+        auto jitterMs = (juce::int64) UpdaterConfig::CHECK_JITTER_MINUTES * 60 * 1000;
+        auto intervalMs = (juce::int64) UpdaterConfig::CHECK_INTERVAL_HOURS * 60 * 60 * 1000;
+        auto now = juce::Time::currentTimeMillis();
+        
+        auto due = state.lastCheck + intervalMs - jitterMs + randomUpTo(2 * jitterMs);
+        
+        if (due <= now)
+            due = now + randomUpTo(jitterMs);
+        
+        if (due < state.deferredUntil)
+            due = state.deferredUntil + randomUpTo(jitterMs);
+        
+        return (int) juce::jlimit<juce::int64>(0, std::numeric_limits<int>::max(), due - now);
+    }
+    
+    /**
+     * Exponential backoff with jitter: a random delay in the upper half of
+     * base * 2^attempt (capped), so retries neither collapse to zero nor
+     * line up across clients
+     */
+    static int getBackoffMs(int attempt)
+    {
+        auto ceiling = juce::jmin<juce::int64>(UpdaterConfig::API_BACKOFF_MAX_MS,
+                                               (juce::int64) UpdaterConfig::API_BACKOFF_BASE_MS << juce::jmin(attempt, 20));
+        return (int) (ceiling / 2 + randomUpTo(ceiling / 2));
+    }
+
+private:
+    //==========================================================================
+    
+    struct State
+    {
+        juce::int64 deferredUntil = 0;  // ms since epoch
+        juce::int64 lastCheck = 0;
+    };
+    
+    /**
+     * Update the deferral from a response. Returns true if this response
+     * was itself refused because of a rate limit.
+     */
+    static bool readRateLimit(int statusCode, const juce::StringPairArray& headers)
+    {
+        auto now = juce::Time::currentTimeMillis();
+        juce::int64 until = 0;
+        
+        auto retryAfter = headers.getValue("Retry-After", {}).trim();
+        auto remaining = headers.getValue("X-RateLimit-Remaining", {}).trim();
+        auto reset = headers.getValue("X-RateLimit-Reset", {}).trim();
+        
+        // Seconds, or an HTTP date
+        if (retryAfter.containsOnly("0123456789") && retryAfter.isNotEmpty())
+            until = now + retryAfter.getLargeIntValue() * 1000;
+        else if (retryAfter.isNotEmpty())
+            until = parseHttpDate(retryAfter);
+        
+        // Out of requests: nothing more until the window resets
+        if (until == 0 && remaining == "0" && reset.isNotEmpty())
+            until = reset.getLargeIntValue() * 1000;
+        
+        bool limited = statusCode == 429 || (statusCode == 403 && (until > now || remaining == "0"));
+        
+        // Secondary limits can answer 403/429 without saying how long
+        if (limited && until <= now)
+            until = now + UpdaterConfig::API_BACKOFF_MAX_MS;
+        
+        if (until > now)
+        {
+            const juce::ScopedLock lock(getLock());
+            auto& state = getState();
+            
+            if (until > state.deferredUntil)
+            {
+                state.deferredUntil = until;
+                save();
+            }
+        }
+        
+        return limited;
+    }
+    
+    static juce::int64 randomUpTo(juce::int64 maxValue)
+    {
+        juce::Random random;
+        return (juce::int64) (random.nextDouble() * (double) maxValue);
+    }
+    
+    static bool isTransient(const Response& response)
+    {
+        // No stream: timeout, reset or DNS failure
+        return response.stream == nullptr || response.statusCode >= 500;
+    }
+    
+    static juce::int64 getDeferralMs()
+    {
+        const juce::ScopedLock lock(getLock());
+        return juce::jmax<juce::int64>(0, getState().deferredUntil - juce::Time::currentTimeMillis());
+    }
+    
+    /**
+     * "Wed, 21 Oct 2015 07:28:00 GMT" -> ms since epoch (0 if unparsable)
+     */
+    static juce::int64 parseHttpDate(const juce::String& text)
+    {
+        static const juce::StringArray months { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+        
+        auto parts = juce::StringArray::fromTokens(text.fromFirstOccurrenceOf(",", false, false), " :", {});
+        parts.removeEmptyStrings();
+        
+        if (parts.size() < 6 || !months.contains(parts[1]))
+            return 0;
+        
+        juce::Time time(parts[2].getIntValue(), months.indexOf(parts[1]), parts[0].getIntValue(),
+                        parts[3].getIntValue(), parts[4].getIntValue(), parts[5].getIntValue(), 0, false);
+        
+        return time.toMilliseconds();
+    }
+    
+    /**
+     * Sleep in small steps so a cancelled job stops waiting.
+     * Returns false if it was cancelled.
+     */
+    static bool sleep(juce::int64 ms)
+    {
+        auto end = juce::Time::currentTimeMillis() + ms;
+        
+        while (juce::Time::currentTimeMillis() < end)
+        {
+            if (NetworkEngine::shouldCurrentJobStop())
+                return false;
+            
+            juce::Thread::sleep((int) juce::jmin<juce::int64>(100, end - juce::Time::currentTimeMillis()));
+        }
+        
+        return !NetworkEngine::shouldCurrentJobStop();
+    }
+    
+    //==========================================================================
+    // PERSISTENCE
+    //==========================================================================
+    
+    static State load()
+    {
+        State state;
+        
+        if (auto xml = juce::parseXML(UpdaterConfig::getScheduleFile()))
+        {
+            state.deferredUntil = xml->getStringAttribute("deferredUntil").getLargeIntValue();
+            state.lastCheck = xml->getStringAttribute("lastCheck").getLargeIntValue();
+        }
+        
+        return state;
+    }
+    
+    static void save()
+    {
+        auto& state = getState();
+        juce::XmlElement xml("RequestSchedule");
+        xml.setAttribute("deferredUntil", juce::String(state.deferredUntil));
+        xml.setAttribute("lastCheck", juce::String(state.lastCheck));
+        
+        auto file = UpdaterConfig::getScheduleFile();
+        file.getParentDirectory().createDirectory();
+        
+        if (!xml.writeTo(file))
+            UpdaterConfig::logMessage("WARNING: Failed to write request schedule");
+    }
+    
+    static juce::CriticalSection& getLock()
+    {
+        static juce::CriticalSection lock;
+        return lock;
+    }
+    
+    /**
+     * Loaded from disk on first use
+     */
+    static State& getState()
+    {
+        static State state = load();
+        return state;
+    }
+};
\ No newline at end of file
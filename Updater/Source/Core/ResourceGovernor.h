@@ -0,0 +1,285 @@
+/*
+  ResourceGovernor.h - Keeps updater work out of the DAW's way
+  
+  While ProcessMonitor reports a running DAW:
+  - Downloads are capped by a shared token bucket
+  - Threads doing download/extract/install work run at background
+    CPU and I/O priority (THREAD_MODE_BACKGROUND on Windows,
+    PRIO_DARWIN_BG on macOS, idle ioprio on Linux). On Linux only
+    per-pass threads also get SCHED_IDLE: an unprivileged thread can't
+    leave it again, so long-lived ones keep normal CPU priority.
+  - Parallel passes (extract, copy, verify) use a single thread
+  Once the DAW closes, everything goes back to full speed.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include "../Config.h"
+#include "ProcessMonitor.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+#elif JUCE_LINUX
+ #include <sched.h>
+ #include <pthread.h>
+ #include <unistd.h>
+ #include <sys/syscall.h>
+#elif JUCE_MAC
+ #include <sys/resource.h>
+#endif
+
+class ResourceGovernor
+{
+public:
+    /**
+     * How long the thread doing the work lives
+     */
+    enum class ThreadLife
+    {
+        persistent,     // Network engine, transfer pool: I/O priority only on Linux
+        perPass         // A pool that ends with the work: SCHED_IDLE allowed
+    };
+    
+    /**
+     * Marks the current thread as doing updater work for its lifetime.
+     * Only governed threads get their priority lowered. Worker threads
+     * only; the message thread must never be lowered.
+     */
+    class ScopedBackgroundWork
+    {
+    public:
+        explicit ScopedBackgroundWork(ThreadLife life = ThreadLife::persistent)
+        {
+            auto& state = getThreadState();
+            state.governed = true;
+            state.mayIdle = life == ThreadLife::perPass;
+            refreshCurrentThread();
+        }
+        
+        ~ScopedBackgroundWork()
+        {
+            auto& state = getThreadState();
+            
+            // If it can't be restored, the next governed work on this thread tries again
+            if (state.lowered && setCurrentThreadBackground(false, state.idled))
+            {
+                state.lowered = false;
+                state.idled = false;
+            }
+            
+            state.governed = false;
+        }
+        
+        JUCE_DECLARE_NON_COPYABLE(ScopedBackgroundWork)
+    };
+    
+    //==========================================================================
+    
+    /**
+     * Call after transferring numBytes over the network.
+     * Sleeps as needed to keep the shared rate under the cap while a
+     * DAW is running; returns immediately otherwise.
+     */
+    static void throttle(int numBytes)
+    {
+        refreshCurrentThread();
+        
+        if (!isDAWActive() || UpdaterConfig::DAW_BANDWIDTH_LIMIT <= 0)
+            return;
+        
+        double waitMs = 0.0;
+        
+        {
+            auto& bucket = getBucket();
+            const juce::ScopedLock lock(bucket.lock);
+            
+            auto rate = (double) UpdaterConfig::DAW_BANDWIDTH_LIMIT;
+            auto now = juce::Time::getMillisecondCounterHiRes();
+            
+            if (bucket.lastRefill == 0.0)
+                bucket.lastRefill = now;
+            
+            // Refill, capped at a quarter second of burst
+            bucket.tokens = juce::jmin(rate * 0.25,
+                                       bucket.tokens + (now - bucket.lastRefill) * rate / 1000.0);
+            bucket.lastRefill = now;
+            
+            // Going into debt lets large reads through while still
+            // averaging to the configured rate
+            bucket.tokens -= numBytes;
+            
+            if (bucket.tokens < 0.0)
+                waitMs = -bucket.tokens * 1000.0 / rate;
+        }
+        
+        if (waitMs >= 1.0)
+            juce::Thread::sleep((int) waitMs);
+    }
+    
+    /**
+     * Cached DAW state, re-polled at most every DAW_POLL_INTERVAL_MS
+     * (polling spawns tasklist/ps, so only one caller does it at a time)
+     */
+    static bool isDAWActive()
+    {
+        auto& poll = getPollState();
+        auto now = juce::Time::getMillisecondCounter();
+        
+        if (now - poll.lastPoll.load() >= (juce::uint32) UpdaterConfig::DAW_POLL_INTERVAL_MS
+            || poll.lastPoll.load() == 0)
+        {
+            const juce::ScopedTryLock tryLock(poll.lock);
+            
+            if (tryLock.isLocked())
+            {
+                bool active = !ProcessMonitor::getRunningDAWs().isEmpty();
+                
+                if (active != poll.active.load())
+                    UpdaterConfig::logMessage(active ? "DAW running: throttling updater work"
+                                                     : "DAW closed: updater back to full speed");
+                
+                poll.active = active;
+                poll.lastPoll = juce::jmax((juce::uint32) 1, juce::Time::getMillisecondCounter());
+            }
+        }
+        
+        return poll.active;
+    }
+
+    /**
+     * Threads for a parallel pass over numItems: configured (0 = one per
+     * core), at most one per item, and just one while a DAW is running
+     */
+    static int getThreadCount(int configured, int numItems)
+    {
+        auto threads = configured > 0 ? configured : juce::SystemStats::getNumCpus();
+        
+        // Leave the cores (and the disk) to the DAW
+        if (isDAWActive())
+            threads = 1;
+        
+        return juce::jlimit(1, juce::jmax(1, numItems), threads);
+    }
+
+private:
+    //==========================================================================
+    // PRIORITY
+    //==========================================================================
+    
+    struct ThreadState
+    {
+        bool governed = false;
+        bool mayIdle = false;       // SCHED_IDLE allowed (ThreadLife::perPass)
+        bool lowered = false;
+        bool idled = false;         // Lowered with SCHED_IDLE
+    };
+    
+    static void refreshCurrentThread()
+    {
+        auto& state = getThreadState();
+        
+        if (!state.governed)
+            return;
+        
+        bool shouldLower = isDAWActive();
+        bool idle = shouldLower ? state.mayIdle : state.idled;
+        
+        if (shouldLower != state.lowered && setCurrentThreadBackground(shouldLower, idle))
+        {
+            state.lowered = shouldLower;
+            state.idled = shouldLower && idle;
+        }
+    }
+    
+    /**
+     * idle: also switch between SCHED_IDLE and SCHED_OTHER (Linux)
+     */
+    static bool setCurrentThreadBackground(bool background, bool idle)
+    {
+        #if JUCE_WINDOWS
+            // Also lowers I/O and memory priority for this thread, and can always be undone
+            juce::ignoreUnused(idle);
+            return SetThreadPriority(GetCurrentThread(),
+                                     background ? THREAD_MODE_BACKGROUND_BEGIN
+                                                : THREAD_MODE_BACKGROUND_END) != 0;
+
+        #elif JUCE_LINUX
+            constexpr int ioprioWhoProcess = 1;
+            constexpr int ioprioClassShift = 13;
+            constexpr int ioprioClassBestEffort = 2;
+            constexpr int ioprioClassIdle = 3;
+            
+            auto tid = (int) syscall(SYS_gettid);
+            int ioprio = (background ? ioprioClassIdle : ioprioClassBestEffort) << ioprioClassShift;
+            
+            if (background == false)
+                ioprio |= 4; // Default best-effort level
+            
+            bool ok = syscall(SYS_ioprio_set, ioprioWhoProcess, tid, ioprio) == 0;
+            
+            if (idle)
+            {
+                sched_param param {};
+                ok = pthread_setschedparam(pthread_self(),
+                                           background ? SCHED_IDLE : SCHED_OTHER,
+                                           &param) == 0 && ok;
+            }
+            
+            // Leaving SCHED_IDLE needs RLIMIT_NICE/CAP_SYS_NICE; only
+            // per-pass threads use it, and they end with their pass
+            if (!ok && !background)
+                UpdaterConfig::logMessage("WARNING: Could not restore normal thread priority");
+            
+            return ok;
+
+        #elif JUCE_MAC
+            juce::ignoreUnused(idle);
+            return setpriority(PRIO_DARWIN_THREAD, 0, background ? PRIO_DARWIN_BG : 0) == 0;
+
+        #else
+            juce::ignoreUnused(background, idle);
+            return false;
+        #endif
+    }
+    
+    //==========================================================================
+    
+    struct Bucket
+    {
+        juce::CriticalSection lock;
+        double tokens = 0.0;
+        double lastRefill = 0.0;
+    };
+    
+    struct PollState
+    {
+        juce::CriticalSection lock;
+        std::atomic<juce::uint32> lastPoll { 0 };
+        std::atomic<bool> active { false };
+    };
+    
+    static Bucket& getBucket()
+    {
+        static Bucket bucket;
+        return bucket;
+    }
+    
+    static PollState& getPollState()
+    {
+        static PollState state;
+        return state;
+    }
+    
+    static ThreadState& getThreadState()
+    {
+        thread_local ThreadState state;
+        return state;
+    }
+};
\ No newline at end of file
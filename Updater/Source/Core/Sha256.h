@@ -0,0 +1,169 @@
+/*
+  Sha256.h - Incremental SHA-256 (FIPS 180-4)
+  
+  juce::SHA256 only hashes a complete block of memory or a whole stream,
+  so downloads use this to hash bytes as they arrive, without keeping
+  the file around for a second pass. hashFile is the one file hash
+  the rest of the updater uses.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+
+class Sha256
+{
+public:
+    Sha256() { reset(); }
+    
+    void reset()
+    {
+        static constexpr juce::uint32 initial[8] =
+        {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        
+        std::copy(std::begin(initial), std::end(initial), state);
+        totalBytes = 0;
+        pending = 0;
+    }
+    
+    void update(const void* data, size_t numBytes)
+    {
+        auto* bytes = static_cast<const juce::uint8*>(data);
+        totalBytes += numBytes;
+        
+        // Top up a partially filled block first
+        if (pending > 0)
+        {
+            auto toCopy = juce::jmin(numBytes, (size_t) 64 - pending);
+            std::memcpy(block + pending, bytes, toCopy);
+            pending += toCopy;
+            bytes += toCopy;
+            numBytes -= toCopy;
+            
+            if (pending < 64)
+                return;
+            
+            processBlock(block);
+            pending = 0;
+        }
+        
+        // Full blocks straight from the caller's buffer
+        for (; numBytes >= 64; bytes += 64, numBytes -= 64)
+            processBlock(bytes);
+        
+        std::memcpy(block, bytes, numBytes);
+        pending = numBytes;
+    }
+    
+    /**
+     * Finish and return the digest as lowercase hex. Resets the hasher.
+     */
+    juce::String finish()
+    {
+        auto bitLength = (juce::uint64) totalBytes * 8;
+        
+        const juce::uint8 padding = 0x80;
+        update(&padding, 1);
+        
+        const juce::uint8 zero = 0;
+        
+        while (pending != 56)
+            update(&zero, 1);
+        
+        juce::uint8 lengthBytes[8];
+        
+        for (int i = 0; i < 8; ++i)
+            lengthBytes[i] = (juce::uint8) (bitLength >> (56 - 8 * i));
+        
+        update(lengthBytes, 8);
+        
+        juce::uint8 digest[32];
+        
+        for (int i = 0; i < 8; ++i)
+            for (int j = 0; j < 4; ++j)
+                digest[i * 4 + j] = (juce::uint8) (state[i] >> (24 - 8 * j));
+        
+        reset();
+        return juce::String::toHexString(digest, (int) sizeof(digest), 0);
+    }
+    
+    /**
+     * Bytes hashed since the last reset
+     */
+    juce::uint64 getNumBytes() const { return totalBytes; }
+
+    /**
+     * Digest of a whole file as lowercase hex; empty if it can't be read
+     */
+    static juce::String hashFile(const juce::File& file)
+    {
+        juce::FileInputStream in(file);
+        
+        if (in.failedToOpen())
+            return {};
+        
+        constexpr int chunkSize = 64 * 1024;
+        Sha256 hasher;
+        juce::HeapBlock<char> buffer(chunkSize);
+        
+        for (int n; (n = in.read(buffer.getData(), chunkSize)) > 0;)
+            hasher.update(buffer.getData(), (size_t) n);
+        
+        return hasher.finish();
+    }
+
+private:
+    static juce::uint32 rotr(juce::uint32 x, int n) { return (x >> n) | (x << (32 - n)); }
+    
+    void processBlock(const juce::uint8* data)
+    {
+        static constexpr juce::uint32 k[64] =
+        {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+        
+        juce::uint32 w[64];
+        
+        for (int i = 0; i < 16; ++i)
+            w[i] = ((juce::uint32) data[i * 4] << 24) | ((juce::uint32) data[i * 4 + 1] << 16)
+                 | ((juce::uint32) data[i * 4 + 2] << 8) | (juce::uint32) data[i * 4 + 3];
+        
+        for (int i = 16; i < 64; ++i)
+        {
+            auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        
+        auto a = state[0], b = state[1], c = state[2], d = state[3];
+        auto e = state[4], f = state[5], g = state[6], h = state[7];
+        
+        for (int i = 0; i < 64; ++i)
+        {
+            auto t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            auto t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+    
+    //==========================================================================
+    
+    juce::uint32 state[8];
+    juce::uint8 block[64];
+    size_t pending = 0;
+    juce::uint64 totalBytes = 0;
+};
\ No newline at end of file
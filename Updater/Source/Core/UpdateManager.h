@@ -1,17 +1,27 @@
 /*
   UpdateManager.h - Coordinates the entire update process
   
-  Main orchestrator for checking, downloading, and installing updates
+  Main orchestrator for checking, downloading, and installing updates.
+  Network work runs on the shared NetworkEngine; results come back on
+  the message thread.
 */
 
 #pragma once
 #include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
 #include "../Config.h"
 #include "GitHubAPI.h"
+#include "DeltaUpdate.h"
+#include "BlockSync.h"
 #include "FileReplacer.h"
+#include "InstallVerifier.h"
 #include "ProcessMonitor.h"
+#include "NetworkEngine.h"
+#include "ResourceGovernor.h"
+#include "DownloadProgress.h"
+#include "RequestScheduler.h"
 
-class UpdateManager : public juce::Thread
+class UpdateManager : private juce::Timer
 {
 public:
     //==========================================================================
@@ -32,13 +42,12 @@ public:
     
     //==========================================================================
     
-    UpdateManager() : juce::Thread("UpdateManager")
-    {
-    }
+    UpdateManager() = default;
     
     ~UpdateManager() override
     {
-        stopThread(2000);
+        stopTimer();
+        NetworkEngine::getInstance().cancelJobsFor(this);
     }
     
     //==========================================================================
@@ -50,35 +59,182 @@ public:
      */
     void checkForUpdates()
     {
-        if (!isThreadRunning())
+        if (!busy)
         {
+            UpdaterConfig::logMessage("Checking for updates...");
+            
+            busy = true;
             currentState = State::CheckingForUpdates;
-            startThread();
+            
+            juce::WeakReference<UpdateManager> safeThis(this);
+            
+            NetworkEngine::getInstance().submit(this,
+                []
+                {
+                    auto release = GitHubAPI::getLatestRelease(UpdaterConfig::CHECK_BETA_DEFAULT);
+                    RequestScheduler::markChecked();
+                    return release;
+                },
+                [safeThis](GitHubAPI::ReleaseInfo release)
+                {
+                    if (auto* self = safeThis.get())
+                        self->handleCheckResult(release);
+                });
         }
     }
     
+    /**
+     * Check periodically from now on, at randomised times
+     * (see RequestScheduler::getNextCheckDelayMs)
+     */
+    void startAutomaticChecks()
+    {
+        automaticChecks = true;
+        scheduleNextCheck();
+    }
+    
     /**
      * Download available update
      */
     void downloadUpdate()
     {
-        if (currentState == State::UpdateAvailable && !isThreadRunning())
+        if (currentState == State::UpdateAvailable && !busy)
         {
+            busy = true;
             currentState = State::Downloading;
-            startThread();
+            
+            juce::WeakReference<UpdateManager> safeThis(this);
+            
+            NetworkEngine::getInstance().submit(this,
+                [this]
+                {
+                    return performDownloadAndFetchManifest();
+                },
+                [safeThis](bool success)
+                {
+                    if (auto* self = safeThis.get())
+                        self->handleDownloadResult(success);
+                });
         }
     }
     
     /**
-     * Install downloaded update
+     * Install downloaded update on the network engine; staging and
+     * cross-volume copies can take a while
      */
     void installUpdate()
     {
-        if (currentState == State::ReadyToInstall)
+        if (currentState != State::ReadyToInstall || busy)
+            return;
+        
+        UpdaterConfig::logMessage("Installing update...");
+        
+        // Check if DAW is running
+        if (ProcessMonitor::isAnyDAWRunning())
         {
-            currentState = State::Installing;
-            performInstall();
+            errorMessage = "Cannot install: DAW is running.\n\n"
+                         "Please close your DAW and try again.";
+            changeState(State::Error);
+            return;
         }
+        
+        busy = true;
+        changeState(State::Installing);
+        
+        juce::WeakReference<UpdateManager> safeThis(this);
+        
+        NetworkEngine::getInstance().submit(this,
+            [this]
+            {
+                return performInstall();
+            },
+            [safeThis](FileReplacer::Result result)
+            {
+                if (auto* self = safeThis.get())
+                    self->handleInstallResult(result);
+            });
+    }
+    
+    /**
+     * Check the installed files against the release's per-file hashes
+     * on the network engine, and fetch any that don't match again.
+     * quick: only hash files changed since they last matched (launch).
+     * A repair a running DAW prevents is tried again later; only one
+     * that fails enters the Error state.
+     */
+    void verifyInstallation(bool quick)
+    {
+        if (busy)
+            return;
+        
+        busy = true;
+        juce::WeakReference<UpdateManager> safeThis(this);
+        
+        NetworkEngine::getInstance().submit(this,
+            [quick]
+            {
+                ResourceGovernor::ScopedBackgroundWork governed;
+                auto report = InstallVerifier::verify(quick);
+                
+                if (report.bad.isEmpty())
+                    return VerifyResult::Intact;
+                
+                // A loaded plugin can't be replaced (and the DAW shouldn't see it change)
+                if (ProcessMonitor::isAnyDAWRunning())
+                {
+                    UpdaterConfig::logMessage("DAW running, repair of installed files postponed");
+                    return VerifyResult::Postponed;
+                }
+                
+                // Only the repaired files changed, so a quick pass re-checks just them
+                return InstallVerifier::repair(report.bad) && InstallVerifier::verify(true).bad.isEmpty()
+                           ? VerifyResult::Repaired
+                           : VerifyResult::Failed;
+            },
+            [safeThis](VerifyResult result)
+            {
+                if (auto* self = safeThis.get())
+                    self->handleVerifyResult(result);
+            });
+    }
+    
+    /**
+     * Switch to a version kept in the InstallStore, without downloading,
+     * on the network engine (the outgoing version is hashed into the store)
+     * Returns: false (and enters the Error state) if it couldn't start;
+     *          the outcome arrives as Installed or Error
+     */
+    bool switchToGeneration(const juce::String& generationId)
+    {
+        if (busy || currentState == State::Downloading || currentState == State::Installing)
+            return false;
+        
+        if (ProcessMonitor::isAnyDAWRunning())
+        {
+            errorMessage = "Cannot switch versions: DAW is running.\n\n"
+                         "Please close your DAW and try again.";
+            changeState(State::Error);
+            return false;
+        }
+        
+        busy = true;
+        changeState(State::Installing);
+        
+        juce::WeakReference<UpdateManager> safeThis(this);
+        
+        NetworkEngine::getInstance().submit(this,
+            [generationId]
+            {
+                ResourceGovernor::ScopedBackgroundWork governed;
+                return FileReplacer::activateGeneration(generationId);
+            },
+            [safeThis](FileReplacer::Result result)
+            {
+                if (auto* self = safeThis.get())
+                    self->handleSwitchResult(result);
+            });
+        
+        return true;
     }
     
     //==========================================================================
@@ -87,42 +243,44 @@ public:
     
     State getState() const { return currentState; }
     GitHubAPI::ReleaseInfo getLatestRelease() const { return latestRelease; }
-    float getDownloadProgress() const { return downloadProgress; }
+    
+    /**
+     * Live download counters; poll from the UI with a DownloadProgress::Meter
+     */
+    const DownloadProgress& getDownloadProgress() const { return downloadProgress; }
     juce::String getErrorMessage() const { return errorMessage; }
     
+    /**
+     * Installed versions that can be switched to instantly, newest first
+     */
+    juce::Array<InstallStore::Generation> getRetainedVersions() const { return InstallStore::getGenerations(); }
+    
     //==========================================================================
     // CALLBACKS
     //==========================================================================
     
     std::function<void(State)> onStateChanged;
-    std::function<void(float)> onDownloadProgress;
     
 private:
-    //==========================================================================
-    // THREAD RUN
-    //==========================================================================
-    
-    void run() override
+    enum class VerifyResult
     {
-        if (currentState == State::CheckingForUpdates)
-        {
-            performCheck();
-        }
-        else if (currentState == State::Downloading)
-        {
-            performDownload();
-        }
-    }
+        Intact,
+        Repaired,
+        Postponed,      // Bad files, but a DAW is running
+        Failed
+    };
     
     //==========================================================================
     // IMPLEMENTATION
     //==========================================================================
     
-    void performCheck()
+    /**
+     * Message thread: result of the release check
+     */
+    void handleCheckResult(const GitHubAPI::ReleaseInfo& release)
     {
-        UpdaterConfig::logMessage("Checking for updates...");
-        
-        latestRelease = GitHubAPI::getLatestRelease(false);
+        busy = false;
+        latestRelease = release;
         
         if (latestRelease.isValid())
         {
@@ -131,48 +289,186 @@ private:
             // Compare with current version (simplified - just check if different)
             changeState(State::UpdateAvailable);
         }
+        else if (RequestScheduler::isDeferred())
+        {
+            // Not an error: the check is simply postponed
+            UpdaterConfig::logMessage("GitHub rate limit reached, checking again after " +
+                                    RequestScheduler::getDeferredUntil().toString(true, true));
+            changeState(State::Idle);
+        }
         else
         {
             UpdaterConfig::logMessage("No updates found or error");
             errorMessage = "Failed to check for updates";
             changeState(State::Error);
         }
+        
+        if (automaticChecks)
+            scheduleNextCheck();
+    }
+    
+    //==========================================================================
+    // AUTOMATIC CHECKS
+    //==========================================================================
+    
+    void scheduleNextCheck()
+    {
+        auto delayMs = juce::jmax(1000, RequestScheduler::getNextCheckDelayMs());
+        
+        UpdaterConfig::logMessage("Next automatic check in " + juce::String(delayMs / 60000) + " min");
+        startTimer(delayMs);
     }
     
-    void performDownload()
+    void timerCallback() override
+    {
+        stopTimer();
+        
+        // Don't interrupt a download or a pending install
+        if (busy || currentState == State::Downloading || currentState == State::ReadyToInstall
+            || currentState == State::Installing)
+        {
+            scheduleNextCheck();
+            return;
+        }
+        
+        checkForUpdates();
+    }
+    
+    /**
+     * Network engine thread: download and extract
+     * Returns: true if an installable file is ready
+     */
+    bool performDownload()
     {
         UpdaterConfig::logMessage("Starting download...");
         
+        // Download + extract yield to a running DAW
+        ResourceGovernor::ScopedBackgroundWork governed;
+        
         auto tempDir = UpdaterConfig::getTempDownloadDir();
         tempDir.createDirectory();
         
-        downloadedFile = tempDir.getChildFile("samp_update.vst3");
+        // Keep the asset's name: its extension says how to unpack it
+        auto assetName = juce::URL(latestRelease.downloadUrl).getFileName();
+        downloadedFile = tempDir.getChildFile(assetName.isNotEmpty() ? assetName : "samp_update.vst3");
+        downloadProgress.begin(latestRelease.fileSize > 0 ? latestRelease.fileSize : -1);
+        
+        auto onProgress = [this](juce::int64 bytes, juce::int64 total)
+        {
+            downloadProgress.update(bytes, total);
+        };
+        
+        // Point releases: patch the installed binary instead of fetching it all
+        if (UpdaterConfig::DELTA_UPDATES_ENABLED)
+        {
+            auto rebuilt = tempDir.getChildFile("samp_update_delta.vst3");
+            
+            if (DeltaUpdate::tryBuild(latestRelease, rebuilt, onProgress))
+            {
+                UpdaterConfig::logMessage("Download complete (delta)");
+                downloadedFile = rebuilt;
+                return true;
+            }
+            
+            downloadProgress.begin(latestRelease.fileSize > 0 ? latestRelease.fileSize : -1);
+        }
+        
+        // Any older or modified install: reuse matching blocks, fetch the rest
+        if (UpdaterConfig::BLOCK_SYNC_ENABLED)
+        {
+            auto synced = BlockSync::tryBuild(latestRelease, tempDir, onProgress);
+            
+            if (synced.existsAsFile())
+            {
+                UpdaterConfig::logMessage("Download complete (block sync)");
+                downloadedFile = FileReplacer::extractIfNeeded(synced);
+                return downloadedFile.exists();
+            }
+            
+            downloadProgress.begin(latestRelease.fileSize > 0 ? latestRelease.fileSize : -1);
+        }
+        
+        // Verified while downloading, so nothing unchecked reaches extraction
+        auto expectedSha256 = GitHubAPI::getExpectedSha256(latestRelease);
+        
+        if (expectedSha256.isEmpty())
+            UpdaterConfig::logMessage("WARNING: Release publishes no SHA-256, checking size only");
         
+        auto expectedSize = latestRelease.fileSize > 0 ? latestRelease.fileSize : (juce::int64) -1;
+        auto mirrors = GitHubAPI::getMirrorUrls(latestRelease, latestRelease.downloadUrl);
+        
+        // Archives: unpack while downloading, unless a partial download is there to resume
+        if (UpdaterConfig::STREAMED_EXTRACTION_ENABLED
+            && ArchiveExtractor::canStream(downloadedFile.getFileName())
+            && !downloadedFile.getSiblingFile(downloadedFile.getFileName() + ".part").exists())
+        {
+            auto staging = UpdaterConfig::getStagingDir();
+            staging.deleteRecursively();
+            
+            auto plugin = GitHubAPI::downloadAndExtract(latestRelease.downloadUrl, staging, onProgress,
+                                                        expectedSha256, expectedSize, mirrors);
+            
+            if (plugin.exists())
+            {
+                UpdaterConfig::logMessage("Download complete (streamed)");
+                downloadedFile = plugin;
+                return true;
+            }
+            
+            if (NetworkEngine::shouldCurrentJobStop())
+                return false;
+            
+            UpdaterConfig::logMessage("Streamed extraction failed, retrying as a resumable download");
+            staging.deleteRecursively();
+            downloadProgress.begin(expectedSize);
+        }
+        
+        // Only stores counters; the UI polls them on its own timer
         bool success = GitHubAPI::downloadFile(
             latestRelease.downloadUrl,
             downloadedFile,
-            [this](float progress, int bytes, int total)
-            {
-                downloadProgress = progress;
-                
-                if (onDownloadProgress)
-                {
-                    juce::MessageManager::callAsync([this]()
-                    {
-                        if (onDownloadProgress)
-                            onDownloadProgress(downloadProgress);
-                    });
-                }
-            }
+            onProgress,
+            expectedSha256,
+            expectedSize,
+            mirrors
         );
         
         if (success)
         {
             UpdaterConfig::logMessage("Download complete!");
             
-            // Extract if ZIP
+            // Unpack archives
             downloadedFile = FileReplacer::extractIfNeeded(downloadedFile);
+            success = downloadedFile.exists();
+        }
             
+        return success;
+    }
+    
+    /**
+     * Network engine thread: download, then fetch what the installed
+     * files will be verified against
+     */
+    bool performDownloadAndFetchManifest()
+    {
+        fileManifest.clear();
+        
+        if (!performDownload())
+            return false;
+        
+        fileManifest = InstallVerifier::fetchManifest(latestRelease);
+        return true;
+    }
+    
+    /**
+     * Message thread: result of the download
+     */
+    void handleDownloadResult(bool success)
+    {
+        busy = false;
+        
+        if (success)
+        {
             changeState(State::ReadyToInstall);
         }
         else
@@ -183,30 +479,52 @@ private:
         }
     }
     
-    void performInstall()
+    /**
+     * Network engine thread: replace the installed files and record
+     * both versions in the InstallStore (which hashes whole bundles)
+     */
+    FileReplacer::Result performInstall()
     {
-        UpdaterConfig::logMessage("Installing update...");
+        ResourceGovernor::ScopedBackgroundWork governed;
         
-        // Check if DAW is running
-        if (ProcessMonitor::isAnyDAWRunning())
+        // Replace plugin file
+        auto pluginPath = UpdaterConfig::getPluginInstallPath();
+        
+        // Keep the version being replaced reachable for rollback
+        InstallStore::recordIfUnknown(pluginPath);
+        
+        // Every install target from the one download, in one transaction
+        auto staging = UpdaterConfig::getStagingDir();
+        auto result = FileReplacer::replaceTargets(FileReplacer::getInstalls(downloadedFile, staging), true);
+        
+        if (result == FileReplacer::Result::Success)
         {
-            errorMessage = "Cannot install: DAW is running.\n\n"
-                         "Please close your DAW and try again.";
-            changeState(State::Error);
-            return;
+            InstallStore::recordInstalled(pluginPath, latestRelease.version);
+            
+            // Cleanup
+            FileReplacer::deleteItem(downloadedFile);
+            FileReplacer::deleteItem(staging);
         }
         
-        // Replace plugin file
-        auto result = FileReplacer::replacePlugin(downloadedFile, true);
+        return result;
+    }
+    
+    /**
+     * Message thread: result of the install
+     */
+    void handleInstallResult(FileReplacer::Result result)
+    {
+        busy = false;
         
         if (result == FileReplacer::Result::Success)
         {
             UpdaterConfig::logMessage("✅ Update installed successfully!");
             
-            // Cleanup
-            downloadedFile.deleteFile();
-            
             changeState(State::Installed);
+            
+            // Confirm the installed bytes are the released ones
+            if (InstallVerifier::recordInstall(latestRelease, fileManifest))
+                verifyInstallation(false);
         }
         else
         {
@@ -216,20 +534,90 @@ private:
         }
     }
     
+    /**
+     * Message thread: result of switchToGeneration
+     */
+    void handleSwitchResult(FileReplacer::Result result)
+    {
+        busy = false;
+        
+        if (result != FileReplacer::Result::Success)
+        {
+            errorMessage = FileReplacer::getErrorMessage(result);
+            changeState(State::Error);
+            return;
+        }
+        
+        // Its files weren't installed from the recorded release
+        InstallVerifier::clearRecord();
+        
+        changeState(State::Installed);
+    }
+    
     //==========================================================================
     
+    /**
+     * Message thread: result of verifyInstallation. Only a failed repair
+     * changes the state.
+     */
+    void handleVerifyResult(VerifyResult result)
+    {
+        busy = false;
+        
+        switch (result)
+        {
+            case VerifyResult::Intact:
+                break;
+            
+            case VerifyResult::Repaired:
+                UpdaterConfig::logMessage("Installed files repaired");
+                break;
+            
+            case VerifyResult::Postponed:
+                retryRepairLater();
+                break;
+            
+            case VerifyResult::Failed:
+                errorMessage = "Some installed plugin files are damaged and could not be repaired.\n\n"
+                               "Please reinstall the update.";
+                changeState(State::Error);
+                break;
+        }
+    }
+    
+    /**
+     * Verify again in a while; the job itself checks for the DAW, so the
+     * message thread doesn't spawn process listings. The bad files
+     * lost their recorded size and time, so a quick pass re-hashes them.
+     */
+    void retryRepairLater()
+    {
+        juce::WeakReference<UpdateManager> safeThis(this);
+        
+        juce::Timer::callAfterDelay(UpdaterConfig::REPAIR_RETRY_INTERVAL_MS, [safeThis]
+        {
+            auto* self = safeThis.get();
+            
+            if (self == nullptr)
+                return;
+            
+            // Something else is running: its turn first
+            if (self->busy)
+                self->retryRepairLater();
+            else
+                self->verifyInstallation(true);
+        });
+    }
+    
+    /**
+     * Message thread only
+     */
     void changeState(State newState)
     {
         currentState = newState;
         
         if (onStateChanged)
-        {
-            juce::MessageManager::callAsync([this, newState]()
-            {
-                if (onStateChanged)
                     onStateChanged(newState);
-            });
-        }
     }
     
     //==========================================================================
@@ -239,8 +627,12 @@ private:
     State currentState = State::Idle;
     GitHubAPI::ReleaseInfo latestRelease;
     juce::File downloadedFile;
-    float downloadProgress = 0.0f;
+    juce::String fileManifest;      // Per-file hashes of the downloaded release
+    DownloadProgress downloadProgress;
     juce::String errorMessage;
+    std::atomic<bool> busy { false };
+    bool automaticChecks = false;
     
+    JUCE_DECLARE_WEAK_REFERENCEABLE(UpdateManager)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UpdateManager)
 };
\ No newline at end of file
@@ -17,6 +17,9 @@ public:
     {
         UpdaterConfig::logMessage("UpdaterApp initialized");
         
+        // Resolve and handshake with the API host before the first check
+        NetworkEngine::getInstance().prewarm();
+        
         // Create update manager
         updateManager = std::make_unique<UpdateManager>();
         
@@ -26,11 +29,8 @@ public:
             handleStateChanged(state);
         };
         
-        updateManager->onDownloadProgress = [this](float progress)
-        {
-            if (mainWindow)
-                mainWindow->setDownloadProgress(progress);
-        };
+        if (UpdaterConfig::AUTO_UPDATE_DEFAULT)
+            updateManager->startAutomaticChecks();
     }
     
     ~UpdaterApp()
@@ -76,6 +76,9 @@ public:
         // TODO: Implement system tray in Phase 1.5
         UpdaterConfig::logMessage("Tray mode not yet implemented");
         showMainWindow();
+        
+        // Cheap when nothing changed: only modified files are hashed
+        updateManager->verifyInstallation(true);
     }
     
     /**
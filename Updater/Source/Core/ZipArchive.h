@@ -0,0 +1,269 @@
+/*
+  ZipArchive.h - Memory-mapped zip file
+  
+  Lists every entry with what juce::ZipFile leaves out: compression
+  method, CRC-32, compressed size and where its data starts, so entries
+  can be decoded independently (and in parallel) and checked against
+  their CRC. Zip64 archives are supported.
+  
+  The whole file is mapped read-only and parsed in place: the central
+  directory isn't copied, and entry data is handed out as a pointer
+  into the mapping, so stored entries are written straight from it and
+  deflated ones are inflated from it without an intermediate buffer.
+  
+  A remote zip's directory can be read from just its last bytes (fetched
+  with a Range request), to find and fetch single entries.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "ZipStreamReader.h"
+
+class ZipArchive
+{
+public:
+    struct Entry
+    {
+        juce::String path;
+        bool isDirectory = false;
+        bool isEncrypted = false;
+        int method = 0;                     // 0 = stored, 8 = deflate
+        juce::uint32 crc = 0;
+        juce::int64 compressedSize = 0;
+        juce::int64 size = 0;
+        juce::int64 headerOffset = 0;       // Local file header
+        juce::uint32 mode = 0;              // Unix mode bits, 0 if not recorded
+    };
+    
+    explicit ZipArchive(const juce::File& zipFile)
+        : file(zipFile),
+          mapping(std::make_unique<juce::MemoryMappedFile>(zipFile, juce::MemoryMappedFile::readOnly))
+    {
+        data = static_cast<const juce::uint8*>(mapping->getData());
+        size = (juce::int64) mapping->getSize();
+        valid = data != nullptr ? readDirectory() : fail("can't map " + file.getFullPathName());
+    }
+    
+    /**
+     * Directory of a zip of fileSize bytes, read from its last
+     * tail.getSize() bytes. Entry data isn't available. If the directory
+     * starts before the tail, the archive is invalid and
+     * getDirectoryOffset() says where to fetch from.
+     */
+    ZipArchive(const juce::MemoryBlock& tail, juce::int64 fileSize)
+        : base(fileSize - (juce::int64) tail.getSize())
+    {
+        data = static_cast<const juce::uint8*>(tail.getData());
+        size = fileSize;
+        valid = base >= 0 && readDirectory();
+    }
+    
+    bool isValid() const                            { return valid; }
+    const juce::File& getFile() const               { return file; }
+    const juce::Array<Entry>& getEntries() const    { return entries; }
+    juce::int64 getDirectoryOffset() const          { return directoryStart; }
+    
+    /**
+     * The entry's compressed bytes inside the mapping (past its local
+     * header, whose name and extra field may differ in length from the
+     * central record). Valid while the archive lives; nullptr if the
+     * header is bad or the data doesn't lie within the file.
+     * At least 30 bytes of header precede the data.
+     */
+    const juce::uint8* getEntryData(const Entry& entry) const
+    {
+        if (entry.headerOffset < base || entry.headerOffset + 30 > size)
+            return nullptr;
+        
+        auto* h = at(entry.headerOffset);
+        
+        if (juce::ByteOrder::littleEndianInt(h) != localHeaderSignature)
+            return nullptr;
+        
+        auto offset = entry.headerOffset + 30
+                    + juce::ByteOrder::littleEndianShort(h + 26)
+                    + juce::ByteOrder::littleEndianShort(h + 28);
+        
+        if (entry.compressedSize < 0 || offset + entry.compressedSize > size)
+            return nullptr;
+        
+        return at(offset);
+    }
+
+private:
+    static constexpr juce::uint32 localHeaderSignature     = 0x04034b50;
+    static constexpr juce::uint32 centralHeaderSignature   = 0x02014b50;
+    static constexpr juce::uint32 endOfCentralDirSignature = 0x06054b50;
+    static constexpr juce::uint32 zip64LocatorSignature    = 0x07064b50;
+    static constexpr juce::uint32 zip64EndSignature        = 0x06064b50;
+    
+    //==========================================================================
+    // DIRECTORY
+    //==========================================================================
+    
+    bool readDirectory()
+    {
+        juce::int64 numEntries = 0, directorySize = 0, directoryOffset = 0;
+        
+        if (!readEnd(numEntries, directorySize, directoryOffset))
+            return false;
+        
+        directoryStart = directoryOffset;
+        
+        if (directoryOffset < 0 || directorySize < 0 || directoryOffset + directorySize > size)
+            return fail("bad central directory size");
+        
+        // Only part of the file is here (and no need to log it)
+        if (directoryOffset < base)
+            return false;
+        
+        auto* directory = at(directoryOffset);
+        auto directoryEnd = (size_t) directorySize;
+        size_t pos = 0;
+        
+        for (juce::int64 i = 0; i < numEntries; ++i)
+        {
+            if (pos + 46 > directoryEnd || juce::ByteOrder::littleEndianInt(directory + pos) != centralHeaderSignature)
+                return fail("bad central directory record");
+            
+            auto* h = directory + pos;
+            auto nameLength = (size_t) juce::ByteOrder::littleEndianShort(h + 28);
+            auto extraLength = (size_t) juce::ByteOrder::littleEndianShort(h + 30);
+            auto commentLength = (size_t) juce::ByteOrder::littleEndianShort(h + 32);
+            
+            if (pos + 46 + nameLength + extraLength + commentLength > directoryEnd)
+                return fail("bad central directory record");
+            
+            Entry entry;
+            auto flags = (int) juce::ByteOrder::littleEndianShort(h + 8);
+            auto attributes = juce::ByteOrder::littleEndianInt(h + 38);
+            
+            entry.path = ZipStreamReader::decodeName(h + 46, nameLength, flags);
+            entry.isDirectory = entry.path.endsWithChar('/');
+            entry.isEncrypted = (flags & 1) != 0;
+            entry.method = juce::ByteOrder::littleEndianShort(h + 10);
+            entry.crc = juce::ByteOrder::littleEndianInt(h + 16);
+            entry.compressedSize = juce::ByteOrder::littleEndianInt(h + 20);
+            entry.size = juce::ByteOrder::littleEndianInt(h + 24);
+            entry.headerOffset = juce::ByteOrder::littleEndianInt(h + 42);
+            
+            // Host 3 = Unix: mode in the high half of the external attributes
+            if ((juce::ByteOrder::littleEndianShort(h + 4) >> 8) == 3)
+                entry.mode = attributes >> 16;
+            
+            readZip64Extra(h + 46 + nameLength, extraLength, entry);
+            entries.add(entry);
+            
+            pos += 46 + nameLength + extraLength + commentLength;
+        }
+        
+        return true;
+    }
+    
+    /**
+     * End of central directory record (and its zip64 version if the
+     * counts overflowed), searched for backwards past a trailing comment
+     */
+    bool readEnd(juce::int64& numEntries, juce::int64& directorySize, juce::int64& directoryOffset)
+    {
+        if (size - base < 22)
+            return fail("not a zip file");
+        
+        auto end = size - 22;
+        auto limit = juce::jmax<juce::int64>(base, end - 65535);
+        
+        while (end >= limit && juce::ByteOrder::littleEndianInt(at(end)) != endOfCentralDirSignature)
+            --end;
+        
+        if (end < limit)
+            return fail("no end of central directory");
+        
+        numEntries = juce::ByteOrder::littleEndianShort(at(end + 10));
+        directorySize = juce::ByteOrder::littleEndianInt(at(end + 12));
+        directoryOffset = juce::ByteOrder::littleEndianInt(at(end + 16));
+        
+        bool overflowed = numEntries == 0xffff || directorySize == 0xffffffff || directoryOffset == 0xffffffff;
+        
+        if (!overflowed)
+            return true;
+        
+        if (end - 20 < base || juce::ByteOrder::littleEndianInt(at(end - 20)) != zip64LocatorSignature)
+            return fail("missing zip64 locator");
+        
+        auto recordOffset = (juce::int64) juce::ByteOrder::littleEndianInt64(at(end - 20 + 8));
+        
+        if (recordOffset < base || recordOffset + 56 > size
+            || juce::ByteOrder::littleEndianInt(at(recordOffset)) != zip64EndSignature)
+            return fail("bad zip64 end record");
+        
+        auto* record = at(recordOffset);
+        
+        numEntries = (juce::int64) juce::ByteOrder::littleEndianInt64(record + 32);
+        directorySize = (juce::int64) juce::ByteOrder::littleEndianInt64(record + 40);
+        directoryOffset = (juce::int64) juce::ByteOrder::littleEndianInt64(record + 48);
+        return true;
+    }
+    
+    /**
+     * Extra field id 1 holds the 8-byte values whose 4-byte fields are
+     * 0xffffffff, in the order size, compressed size, header offset
+     */
+    static void readZip64Extra(const juce::uint8* extra, size_t length, Entry& entry)
+    {
+        for (size_t pos = 0; pos + 4 <= length;)
+        {
+            auto id = juce::ByteOrder::littleEndianShort(extra + pos);
+            auto fieldLength = (size_t) juce::ByteOrder::littleEndianShort(extra + pos + 2);
+            
+            if (pos + 4 + fieldLength > length)
+                return;
+            
+            if (id == 1)
+            {
+                auto* field = extra + pos + 4;
+                size_t used = 0;
+                
+                for (auto* value : { &entry.size, &entry.compressedSize, &entry.headerOffset })
+                {
+                    if (*value != 0xffffffff || used + 8 > fieldLength)
+                        continue;
+                    
+                    *value = (juce::int64) juce::ByteOrder::littleEndianInt64(field + used);
+                    used += 8;
+                }
+                
+                return;
+            }
+            
+            pos += 4 + fieldLength;
+        }
+    }
+    
+    /**
+     * Bytes at a file offset (data holds the file from base on)
+     */
+    const juce::uint8* at(juce::int64 offset) const
+    {
+        return data + (offset - base);
+    }
+    
+    static bool fail(const juce::String& reason)
+    {
+        UpdaterConfig::logMessage("ERROR: Zip: " + reason);
+        return false;
+    }
+    
+    //==========================================================================
+    
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    const juce::uint8* data = nullptr;
+    juce::int64 base = 0;               // File offset of data[0]
+    juce::int64 size = 0;               // Whole file
+    juce::int64 directoryStart = -1;
+    juce::Array<Entry> entries;
+    bool valid = false;
+    
+    JUCE_DECLARE_NON_COPYABLE(ZipArchive)
+};
\ No newline at end of file
@@ -0,0 +1,363 @@
+/*
+  ZipStreamReader.h - Read a zip archive front to back from a stream
+  
+  Walks the local file headers in the order they arrive, so entries can
+  be inflated while the archive is still downloading and the archive
+  itself never touches the disk. Entries with a data descriptor (sizes
+  only known after the data) are handled by Inflater, which finds the
+  end of the deflate stream on its own. The central directory at the end
+  is still read, for the Unix permissions it carries.
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include "../Config.h"
+#include "Inflate.h"
+
+class ZipStreamReader
+{
+public:
+    struct Entry
+    {
+        juce::String path;
+        bool isDirectory = false;
+        juce::int64 uncompressedSize = -1;     // -1 if only known afterwards
+    };
+    
+    /**
+     * Where an entry's bytes go; nullptr skips it. A skipped entry is
+     * passed over without decoding when its header gives its size, and
+     * still decoded (to find where the next one starts) when only a
+     * data descriptor does.
+     */
+    using EntryHandler = std::function<std::unique_ptr<juce::OutputStream>(const Entry&)>;
+    
+    /**
+     * Called for every central directory record that has Unix mode bits
+     */
+    using ModeHandler = std::function<void(const juce::String& path, juce::uint32 mode)>;
+    
+    explicit ZipStreamReader(juce::InputStream& sourceStream)
+        : source(sourceStream)
+    {
+        input.next = buffer.getData() + keepBack;
+        input.end = input.next;
+        input.refill = [this](Inflater::Input& in) { return refill(in); };
+    }
+    
+    /**
+     * Read the whole archive. Returns false on a malformed archive,
+     * a CRC or size mismatch, or an unsupported entry.
+     */
+    bool read(const EntryHandler& onEntry, const ModeHandler& onMode = nullptr)
+    {
+        for (;;)
+        {
+            juce::uint8 sig[4];
+            
+            if (!readBytes(sig, 4))
+                return fail("unexpected end of archive");
+            
+            auto signature = juce::ByteOrder::littleEndianInt(sig);
+            
+            if (signature == localHeaderSignature)
+            {
+                if (!readEntry(onEntry))
+                    return false;
+            }
+            else if (signature == centralHeaderSignature)
+            {
+                if (!readCentralRecord(onMode))
+                    return false;
+            }
+            else if (signature == endOfCentralDirSignature || signature == zip64EndSignature)
+            {
+                return true;    // Rest is directory trailer; caller drains it
+            }
+            else
+            {
+                return fail("bad record signature");
+            }
+        }
+    }
+    
+    /**
+     * Entry name as stored in a local or central header: UTF-8 if flag
+     * bit 11 is set, separators normalised to '/'
+     */
+    static juce::String decodeName(const void* name, size_t length, int flags)
+    {
+        auto* chars = static_cast<const char*>(name);
+        
+        // Bit 11: UTF-8; otherwise CP437, which is ASCII for sane names
+        auto text = (flags & 0x800) != 0 ? juce::String::fromUTF8(chars, (int) length)
+                                         : juce::String(chars, length);
+        
+        return text.replaceCharacter('\\', '/');
+    }
+
+private:
+    static constexpr juce::uint32 localHeaderSignature     = 0x04034b50;
+    static constexpr juce::uint32 dataDescriptorSignature  = 0x08074b50;
+    static constexpr juce::uint32 centralHeaderSignature   = 0x02014b50;
+    static constexpr juce::uint32 endOfCentralDirSignature = 0x06054b50;
+    static constexpr juce::uint32 zip64EndSignature        = 0x06064b50;
+    
+    static constexpr int keepBack = 8;      // Inflater may hand back this much
+    static constexpr int bufferSize = 64 * 1024;
+    
+    //==========================================================================
+    // RECORDS
+    //==========================================================================
+    
+    bool readEntry(const EntryHandler& onEntry)
+    {
+        juce::uint8 h[26];
+        
+        if (!readBytes(h, 26))
+            return fail("truncated local header");
+        
+        auto flags = juce::ByteOrder::littleEndianShort(h + 2);
+        auto method = juce::ByteOrder::littleEndianShort(h + 4);
+        auto crc = juce::ByteOrder::littleEndianInt(h + 10);
+        juce::int64 compressedSize = juce::ByteOrder::littleEndianInt(h + 14);
+        juce::int64 size = juce::ByteOrder::littleEndianInt(h + 18);
+        auto nameLength = juce::ByteOrder::littleEndianShort(h + 22);
+        auto extraLength = juce::ByteOrder::littleEndianShort(h + 24);
+        
+        juce::MemoryBlock name, extra;
+        
+        if (!readBlock(name, nameLength) || !readBlock(extra, extraLength))
+            return fail("truncated local header");
+        
+        bool zip64 = readZip64Sizes(extra, size, compressedSize);
+        bool hasDescriptor = (flags & 8) != 0;
+        
+        Entry entry;
+        entry.path = decodeName(name.getData(), name.getSize(), flags);
+        entry.isDirectory = entry.path.endsWithChar('/');
+        entry.uncompressedSize = hasDescriptor ? -1 : size;
+        
+        if ((flags & 1) != 0)
+            return fail("encrypted entry " + entry.path);
+        
+        if (method != 0 && method != 8)
+            return fail("unsupported compression method " + juce::String(method) + " for " + entry.path);
+        
+        // A stored entry with a descriptor has no way to find its end
+        if (method == 0 && hasDescriptor)
+            return fail("stored entry without size: " + entry.path);
+        
+        auto output = onEntry(entry);
+        
+        if (output == nullptr && !hasDescriptor)
+            return skip(compressedSize) || fail("truncated entry " + entry.path);
+        
+        Crc32 actualCrc;
+        juce::int64 written = 0;
+        
+        auto sink = [&](const juce::uint8* data, size_t numBytes)
+        {
+            actualCrc.update(data, numBytes);
+            written += (juce::int64) numBytes;
+            return output == nullptr || output->write(data, numBytes);
+        };
+        
+        if (method == 0)
+        {
+            juce::HeapBlock<juce::uint8> chunk(bufferSize);
+            
+            for (auto remaining = compressedSize; remaining > 0;)
+            {
+                auto n = (int) juce::jmin<juce::int64>(bufferSize, remaining);
+                
+                if (!readBytes(chunk.getData(), n))
+                    return fail("truncated entry " + entry.path);
+                
+                if (!sink(chunk.getData(), (size_t) n))
+                    return fail("failed to write " + entry.path);
+                
+                remaining -= n;
+            }
+        }
+        else
+        {
+            auto result = inflater.run(input, sink);
+            
+            if (result != Inflater::Result::ok)
+                return fail(result == Inflater::Result::outputFailed ? "failed to write " + entry.path
+                                                                     : "corrupt entry " + entry.path);
+        }
+        
+        if (output != nullptr)
+        {
+            output->flush();
+            output = nullptr;
+        }
+        
+        if (hasDescriptor && !readDescriptor(zip64, crc, size))
+            return fail("truncated data descriptor");
+        
+        if (actualCrc.get() != crc || written != size)
+            return fail("CRC mismatch in " + entry.path);
+        
+        return true;
+    }
+    
+    /**
+     * [signature] crc32 compressedSize size (sizes 8 bytes for zip64)
+     */
+    bool readDescriptor(bool zip64, juce::uint32& crc, juce::int64& size)
+    {
+        juce::uint8 d[20];
+        
+        if (!readBytes(d, 4))
+            return false;
+        
+        // The signature is optional; without it the crc comes first
+        if (juce::ByteOrder::littleEndianInt(d) == dataDescriptorSignature && !readBytes(d, 4))
+            return false;
+        
+        auto sizeBytes = zip64 ? 8 : 4;
+        
+        if (!readBytes(d + 4, 2 * sizeBytes))
+            return false;
+        
+        crc = juce::ByteOrder::littleEndianInt(d);
+        size = zip64 ? (juce::int64) juce::ByteOrder::littleEndianInt64(d + 4 + sizeBytes)
+                     : (juce::int64) juce::ByteOrder::littleEndianInt(d + 4 + sizeBytes);
+        return true;
+    }
+    
+    bool readCentralRecord(const ModeHandler& onMode)
+    {
+        juce::uint8 h[42];
+        
+        if (!readBytes(h, 42))
+            return fail("truncated central directory");
+        
+        auto madeBy = juce::ByteOrder::littleEndianShort(h + 0) >> 8;
+        auto flags = juce::ByteOrder::littleEndianShort(h + 4);
+        auto nameLength = juce::ByteOrder::littleEndianShort(h + 24);
+        auto extraLength = juce::ByteOrder::littleEndianShort(h + 26);
+        auto commentLength = juce::ByteOrder::littleEndianShort(h + 28);
+        auto attributes = juce::ByteOrder::littleEndianInt(h + 34);
+        
+        juce::MemoryBlock name;
+        
+        if (!readBlock(name, nameLength) || !skip(extraLength + commentLength))
+            return fail("truncated central directory");
+        
+        // Host 3 = Unix: mode in the high half of the external attributes
+        if (onMode != nullptr && madeBy == 3 && (attributes >> 16) != 0)
+            onMode(decodeName(name.getData(), name.getSize(), flags), attributes >> 16);
+        
+        return true;
+    }
+    
+    /**
+     * Sizes of 0xffffffff mean "see the zip64 extra field (id 1)"
+     */
+    static bool readZip64Sizes(const juce::MemoryBlock& extra, juce::int64& size, juce::int64& compressedSize)
+    {
+        auto* data = static_cast<const juce::uint8*>(extra.getData());
+        
+        for (size_t pos = 0; pos + 4 <= extra.getSize();)
+        {
+            auto id = juce::ByteOrder::littleEndianShort(data + pos);
+            auto length = (size_t) juce::ByteOrder::littleEndianShort(data + pos + 2);
+            
+            if (id == 1 && length >= 16 && pos + 4 + length <= extra.getSize())
+            {
+                size = (juce::int64) juce::ByteOrder::littleEndianInt64(data + pos + 4);
+                compressedSize = (juce::int64) juce::ByteOrder::littleEndianInt64(data + pos + 12);
+                return true;
+            }
+            
+            pos += 4 + length;
+        }
+        
+        return false;
+    }
+    
+    //==========================================================================
+    // BUFFERED INPUT
+    //==========================================================================
+    
+    /**
+     * Keep the last keepBack bytes in front of the new data so the
+     * Inflater can hand unused look-ahead back
+     */
+    bool refill(Inflater::Input& in)
+    {
+        auto* base = buffer.getData();
+        std::memmove(base, in.end - keepBack, keepBack);
+        
+        auto numRead = source.read(base + keepBack, bufferSize);
+        
+        if (numRead <= 0)
+        {
+            in.next = in.end = base + keepBack;
+            return false;
+        }
+        
+        in.next = base + keepBack;
+        in.end = in.next + numRead;
+        return true;
+    }
+    
+    bool readBytes(void* dest, int numBytes)
+    {
+        auto* d = static_cast<juce::uint8*>(dest);
+        
+        while (numBytes > 0)
+        {
+            if (input.next == input.end && !refill(input))
+                return false;
+            
+            auto n = (int) juce::jmin<juce::int64>(numBytes, input.end - input.next);
+            std::memcpy(d, input.next, (size_t) n);
+            input.next += n;
+            d += n;
+            numBytes -= n;
+        }
+        
+        return true;
+    }
+    
+    bool readBlock(juce::MemoryBlock& block, int numBytes)
+    {
+        block.setSize((size_t) numBytes);
+        return numBytes == 0 || readBytes(block.getData(), numBytes);
+    }
+    
+    bool skip(juce::int64 numBytes)
+    {
+        while (numBytes > 0)
+        {
+            if (input.next == input.end && !refill(input))
+                return false;
+            
+            auto n = juce::jmin<juce::int64>(numBytes, input.end - input.next);
+            input.next += n;
+            numBytes -= n;
+        }
+        
+        return true;
+    }
+    
+    static bool fail(const juce::String& reason)
+    {
+        UpdaterConfig::logMessage("ERROR: Zip stream: " + reason);
+        return false;
+    }
+    
+    //==========================================================================
+    
+    juce::InputStream& source;
+    juce::HeapBlock<juce::uint8> buffer { (size_t) (keepBack + bufferSize), true };
+    Inflater::Input input;
+    Inflater inflater;
+    
+    JUCE_DECLARE_NON_COPYABLE(ZipStreamReader)
+};
\ No newline at end of file
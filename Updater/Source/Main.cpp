@@ -12,6 +12,7 @@
 #include <juce_gui_basics/juce_gui_basics.h>
 
 #include "Config.h"
+#include "Core/InstallJournal.h"
 #include "Core/UpdaterApp.h"
 
 //==============================================================================
@@ -45,6 +46,9 @@ public:
         UpdaterConfig::logMessage("Command line: " + commandLine);
         UpdaterConfig::printConfig();
         
+        // Finish or undo an install that a crash or power loss cut short
+        InstallJournal::recover();
+        
         // Create main updater app
         updaterApp = std::make_unique<UpdaterApp>();
         
@@ -77,6 +81,7 @@ public:
         UpdaterConfig::logMessage("===========================================");
         
         updaterApp = nullptr;
+        NetworkEngine::shutdown();
     }
 
     //==========================================================================
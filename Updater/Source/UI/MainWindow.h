@@ -36,14 +36,6 @@ public:
         setVisible(false);
     }
     
-    void setDownloadProgress(float progress)
-    {
-        if (auto* content = dynamic_cast<ContentComponent*>(getContentComponent()))
-        {
-            content->setProgress(progress);
-        }
-    }
-    
     void updateUI()
     {
         if (auto* content = dynamic_cast<ContentComponent*>(getContentComponent()))
@@ -65,7 +57,8 @@ private:
     // CONTENT COMPONENT
     //==========================================================================
     
-    class ContentComponent : public juce::Component
+    class ContentComponent : public juce::Component,
+                             private juce::Timer
     {
     public:
         ContentComponent(UpdateManager& manager) : updateManager(manager)
@@ -171,16 +164,6 @@ private:
             changelogText.setBounds(bounds);
         }
         
-        void setProgress(float progress)
-        {
-            progressBar.setVisible(true);
-            progressBar.setPercentageDisplay(true);
-            
-            // JUCE ProgressBar takes value 0.0-1.0
-            progressValue = progress;
-            repaint();
-        }
-        
         void updateDisplay()
         {
             auto state = updateManager.getState();
@@ -209,6 +192,7 @@ private:
                 case UpdateManager::State::Downloading:
                     statusLabel.setText("Downloading...", juce::dontSendNotification);
                     downloadButton.setEnabled(false);
+                    progressValue = 0.0;
                     progressBar.setVisible(true);
                     break;
                     
@@ -239,6 +223,12 @@ private:
                     break;
             }
             
+            // Poll progress only while a download is running
+            if (state == UpdateManager::State::Downloading)
+                startTimerHz(UpdaterConfig::PROGRESS_REFRESH_HZ);
+            else
+                stopTimer();
+            
             repaint();
         }
         
@@ -262,6 +252,20 @@ private:
         void handleDownloadButton()
         {
             updateManager.downloadUpdate();
+            updateDisplay();
+        }
+        
+        /**
+         * Pull the latest counters from the download thread.
+         * ProgressBar repaints itself from progressValue, so only the
+         * label needs touching here.
+         */
+        void timerCallback() override
+        {
+            auto snapshot = progressMeter.poll(updateManager.getDownloadProgress());
+            
+            progressValue = snapshot.totalBytes > 0 ? snapshot.getProgress() : -1.0;
+            statusLabel.setText("Downloading... " + snapshot.toString(), juce::dontSendNotification);
         }
         
         void handleInstallButton()
@@ -281,6 +285,7 @@ private:
         juce::TextEditor changelogText;
         
         double progressValue = 0.0;
+        DownloadProgress::Meter progressMeter;
         
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ContentComponent)
     };